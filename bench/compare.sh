@@ -0,0 +1,70 @@
+#!/usr/bin/env bash
+# Before/after wall time and peak RSS: build BASE_REV in a scratch worktree
+# and run it against the current ./zig-out/bin/lg on the same directory.
+#
+# Usage: bench/compare.sh [BASE_REV] [ENTRIES]
+#   BASE_REV  git revision to compare against (default HEAD~1)
+#   ENTRIES   number of files in the scratch directory (default 1000000)
+#
+# Each flag set below is run RUNS times per binary (default 3); the median
+# wall time and the largest peak RSS are reported.
+# Requires GNU time (/usr/bin/time) and zig.
+
+set -euo pipefail
+
+BASE_REV="${1:-HEAD~1}"
+ENTRIES="${2:-1000000}"
+RUNS="${RUNS:-3}"
+AFTER="${LG:-./zig-out/bin/lg}"
+TIME_BIN="${TIME_BIN:-/usr/bin/time}"
+
+if [ ! -x "$TIME_BIN" ]; then
+    echo "error: GNU time not found at $TIME_BIN" >&2
+    exit 1
+fi
+if [ ! -x "$AFTER" ]; then
+    echo "error: $AFTER not found (run 'make release' first)" >&2
+    exit 1
+fi
+
+SCRATCH="$(mktemp -d)"
+WORKTREE="$SCRATCH/base"
+cleanup() {
+    git worktree remove --force "$WORKTREE" >/dev/null 2>&1 || true
+    rm -rf "$SCRATCH"
+}
+trap cleanup EXIT
+
+echo "building $BASE_REV ..." >&2
+git worktree add --detach "$WORKTREE" "$BASE_REV" >/dev/null 2>&1
+( cd "$WORKTREE" && zig build -Doptimize=ReleaseFast >/dev/null )
+BEFORE="$WORKTREE/zig-out/bin/lg"
+
+DIR="$SCRATCH/dir"
+mkdir -p "$DIR"
+( cd "$DIR" && seq -f "file_%07g.txt" 1 "$ENTRIES" | xargs touch )
+
+# Prints "<median seconds> <max RSS KB>"
+measure() {
+    local bin="$1"; shift
+    local report times=() rss=0 r
+    report="$(mktemp)"
+    for _ in $(seq "$RUNS"); do
+        "$TIME_BIN" -f '%e %M' -o "$report" "$bin" "$@" "$DIR" >/dev/null
+        read -r t r < "$report"
+        times+=("$t")
+        [ "$r" -gt "$rss" ] && rss="$r"
+    done
+    rm -f "$report"
+    printf '%s %s\n' "$(printf '%s\n' "${times[@]}" | sort -n | sed -n "$(( (RUNS + 1) / 2 ))p")" "$rss"
+}
+
+echo "entries: $ENTRIES, base: $BASE_REV, runs: $RUNS"
+printf '%-10s %12s %12s %14s %14s\n' "flags" "before (s)" "after (s)" "before (KB)" "after (KB)"
+for flags in "" "-U -1" "-n" "-s" "-ll"; do
+    # shellcheck disable=SC2086
+    read -r bt br < <(measure "$BEFORE" $flags)
+    # shellcheck disable=SC2086
+    read -r at ar < <(measure "$AFTER" $flags)
+    printf '%-10s %12s %12s %14s %14s\n' "${flags:-(none)}" "$bt" "$at" "$br" "$ar"
+done
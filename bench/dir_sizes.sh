@@ -0,0 +1,69 @@
+#!/usr/bin/env bash
+# Time -d on wide directories against du.
+#
+# Usage: bench/dir_sizes.sh [SUBDIRS...]
+#   SUBDIRS  subdirectory counts to test, one scratch tree each
+#            (default: 10000 50000)
+#
+# Each subdirectory holds FILES (default 2) small files. Rows:
+#   du -d 1        one du walk reporting every child (the baseline)
+#   lg -d jobs=N   lg's native walk on N threads; "auto" sizes the pool itself
+#
+# Uses ./zig-out/bin/lg unless LG is set.
+
+set -euo pipefail
+
+RUNS="${RUNS:-5}"
+FILES="${FILES:-2}"
+LG="${LG:-./zig-out/bin/lg}"
+if [ "$#" -eq 0 ]; then
+    set -- 10000 50000
+fi
+
+if [ ! -x "$LG" ]; then
+    echo "error: $LG not found (run 'make release' first)" >&2
+    exit 1
+fi
+
+SCRATCH="$(mktemp -d)"
+trap 'rm -rf "$SCRATCH"' EXIT
+
+# Median wall time in milliseconds of RUNS invocations of "$@"
+median_ms() {
+    local times=()
+    for _ in $(seq 1 "$RUNS"); do
+        local start end
+        start=$(date +%s%N)
+        "$@" >/dev/null 2>&1
+        end=$(date +%s%N)
+        times+=( $(( (end - start) / 1000000 )) )
+    done
+    printf '%s\n' "${times[@]}" | sort -n | awk '{ a[NR] = $1 } END { print a[int((NR + 1) / 2)] }'
+}
+
+# name | extra lg args
+CONFIGS=(
+    "lg -d jobs=1|--jobs 1"
+    "lg -d jobs=4|--jobs 4"
+    "lg -d auto|"
+)
+
+echo "files per subdir: $FILES, runs: $RUNS (median)"
+printf '%-8s %-16s %8s\n' "subdirs" "command" "wall"
+for subdirs in "$@"; do
+    dir="$SCRATCH/tree_$subdirs"
+    mkdir -p "$dir"
+    ( cd "$dir" && seq -f "dir_%07g" 1 "$subdirs" | xargs mkdir )
+    for f in $(seq 1 "$FILES"); do
+        ( cd "$dir" && seq -f "dir_%07g/file_$f" 1 "$subdirs" | xargs touch )
+    done
+
+    printf '%-8s %-16s %5s ms\n' "$subdirs" "du -d 1" "$(median_ms du -k -d 1 "$dir")"
+    for config in "${CONFIGS[@]}"; do
+        name="${config%%|*}"
+        args="${config#*|}"
+        # shellcheck disable=SC2086
+        printf '%-8s %-16s %5s ms\n' "$subdirs" "$name" "$(median_ms "$LG" -d --porcelain $args "$dir")"
+    done
+    rm -rf "$dir"
+done
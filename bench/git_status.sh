@@ -0,0 +1,89 @@
+#!/usr/bin/env bash
+# Measure what each git status tuning saves on a dirty repository.
+#
+# Usage: bench/git_status.sh [FILES] [CHANGED]
+#   FILES    tracked files in the scratch repository (default 20000)
+#   CHANGED  files modified, renamed and added untracked, each (default 2000)
+#
+# The scratch repo has a submodule with local changes, so the submodule
+# setting has something to skip. Rows:
+#   git (locks)      plain `git status --porcelain=v2`, may take index.lock
+#   git (no locks)   the same with GIT_OPTIONAL_LOCKS=0 (what lg runs)
+#   lg ...           lg with each --git-* tuning on its own, then all together
+#
+# Uses ./zig-out/bin/lg unless LG is set. Requires git.
+
+set -euo pipefail
+
+FILES="${1:-20000}"
+CHANGED="${2:-2000}"
+RUNS="${RUNS:-5}"
+LG="${LG:-./zig-out/bin/lg}"
+
+if [ ! -x "$LG" ]; then
+    echo "error: $LG not found (run 'make release' first)" >&2
+    exit 1
+fi
+LG="$(realpath "$LG")"
+
+SCRATCH="$(mktemp -d)"
+trap 'rm -rf "$SCRATCH"' EXIT
+export GIT_AUTHOR_NAME=bench GIT_AUTHOR_EMAIL=bench@example.com
+export GIT_COMMITTER_NAME=bench GIT_COMMITTER_EMAIL=bench@example.com
+
+git init -q "$SCRATCH/sub"
+echo sub >"$SCRATCH/sub/file"
+git -C "$SCRATCH/sub" add file
+git -C "$SCRATCH/sub" commit -qm sub
+
+REPO="$SCRATCH/repo"
+git init -q "$REPO"
+mkdir -p "$REPO/src"
+( cd "$REPO/src" && seq -f "file_%07g.txt" 1 "$FILES" | xargs -n 1000 sh -c 'for f; do echo "$f" >"$f"; done' _ )
+git -C "$REPO" -c protocol.file.allow=always submodule add -q "$SCRATCH/sub" sub
+git -C "$REPO" add -A
+git -C "$REPO" commit -qm base
+
+# Modified, renamed (staged), untracked and a dirty submodule
+( cd "$REPO/src" && seq -f "file_%07g.txt" 1 "$CHANGED" | xargs -n 1000 sh -c 'for f; do echo changed >>"$f"; done' _ )
+( cd "$REPO/src" && seq -f "%07g" $((CHANGED + 1)) $((CHANGED * 2)) | while read -r n; do git mv "file_$n.txt" "moved_$n.txt"; done )
+( cd "$REPO/src" && seq -f "new_%07g.tmp" 1 "$CHANGED" | xargs touch )
+echo dirty >>"$REPO/sub/file"
+
+# Median wall time in milliseconds of RUNS invocations of "$@" (run in $REPO)
+median_ms() {
+    local times=()
+    for _ in $(seq 1 "$RUNS"); do
+        local start end
+        start=$(date +%s%N)
+        ( cd "$REPO" && "$@" ) >/dev/null 2>&1
+        end=$(date +%s%N)
+        times+=( $(( (end - start) / 1000000 )) )
+    done
+    printf '%s\n' "${times[@]}" | sort -n | awk '{ a[NR] = $1 } END { print a[int((NR + 1) / 2)] }'
+}
+
+# name | extra lg args
+CONFIGS=(
+    "lg default|"
+    "lg no renames|--git-no-renames"
+    "lg untracked=no|--git-untracked=no"
+    "lg untracked=all|--git-untracked=all"
+    "lg submodules=all|--git-submodules=all"
+    "lg all tunings|--git-no-renames --git-untracked=no --git-submodules=all"
+)
+
+echo "files: $FILES, changed: $CHANGED x3, runs: $RUNS (median)"
+printf '%-20s %8s\n' "config" "wall"
+printf '%-20s %5s ms\n' "git (locks)" "$(median_ms git status --porcelain=v2)"
+printf '%-20s %5s ms\n' "git (no locks)" "$(median_ms env GIT_OPTIONAL_LOCKS=0 git status --porcelain=v2)"
+
+base=""
+for config in "${CONFIGS[@]}"; do
+    name="${config%%|*}"
+    args="${config#*|}"
+    # shellcheck disable=SC2086
+    ms=$(median_ms "$LG" --porcelain $args)
+    base="${base:-$ms}"
+    printf '%-20s %5s ms  (%+d ms vs default)\n' "$name" "$ms" $((ms - base))
+done
@@ -0,0 +1,65 @@
+#!/usr/bin/env bash
+# Report wall time and peak RSS of lg on a large directory.
+#
+# Usage: bench/memory.sh [ENTRIES] [LG_ARGS...]
+#   ENTRIES  number of files to create in the scratch directory (default 1000000)
+#   LG_ARGS  extra flags passed to lg (default: none)
+#
+# Requires GNU time (/usr/bin/time). Uses ./zig-out/bin/lg unless LG is set.
+# Set BASE_LG to another build (e.g. one from before a change) to report it
+# on the same directory first, as a before/after pair.
+# Set SCRATCH_DIR to reuse an existing populated directory between runs.
+
+set -euo pipefail
+
+ENTRIES="${1:-1000000}"
+shift || true
+LG="${LG:-./zig-out/bin/lg}"
+TIME_BIN="${TIME_BIN:-/usr/bin/time}"
+
+if [ ! -x "$TIME_BIN" ]; then
+    echo "error: GNU time not found at $TIME_BIN" >&2
+    exit 1
+fi
+if [ ! -x "$LG" ]; then
+    echo "error: $LG not found (run 'make release' first)" >&2
+    exit 1
+fi
+if [ -n "${BASE_LG:-}" ] && [ ! -x "$BASE_LG" ]; then
+    echo "error: BASE_LG=$BASE_LG is not executable" >&2
+    exit 1
+fi
+
+if [ -n "${SCRATCH_DIR:-}" ]; then
+    DIR="$SCRATCH_DIR"
+else
+    SCRATCH="$(mktemp -d)"
+    trap 'rm -rf "$SCRATCH"' EXIT
+    DIR="$SCRATCH/dir"
+fi
+
+if [ ! -d "$DIR" ] || [ "$(find "$DIR" -maxdepth 1 -type f | head -n "$ENTRIES" | wc -l)" -lt "$ENTRIES" ]; then
+    mkdir -p "$DIR"
+    ( cd "$DIR" && seq -f "file_%07g.txt" 1 "$ENTRIES" | xargs touch )
+fi
+
+REPORT="$(mktemp)"
+trap 'rm -f "$REPORT"; if [ -n "${SCRATCH:-}" ]; then rm -rf "$SCRATCH"; fi' EXIT
+
+# Wall time and peak RSS of one binary on $DIR
+report() {
+    local label="$1" bin="$2"
+    shift 2
+    "$TIME_BIN" -v -o "$REPORT" "$bin" "$@" "$DIR" >/dev/null
+    echo "[$label] $bin"
+    grep -E 'Elapsed \(wall clock\)|Maximum resident set size' "$REPORT" | sed 's/^[[:space:]]*/  /'
+}
+
+echo "entries:            $ENTRIES"
+echo "lg args:            ${*:-(none)}"
+if [ -n "${BASE_LG:-}" ]; then
+    report before "$BASE_LG" "$@"
+    report after "$LG" "$@"
+else
+    report lg "$LG" "$@"
+fi
@@ -0,0 +1,85 @@
+#!/usr/bin/env bash
+# Compare metadata collection strategies on a large directory.
+#
+# Usage: bench/stat_backends.sh [ENTRIES] [LATENCY_US]
+#   ENTRIES     number of files in the scratch directory (default 100000)
+#   LATENCY_US  per-stat latency injected for the high-latency run (default 200)
+#
+# Backends: fstatat (serial), the thread pool (--jobs / --stat-backend=threads)
+# and io_uring (--stat-backend=io_uring).
+#
+# Two scenarios:
+#   local    plain run on the scratch directory's filesystem (ext4/tmpfs/...)
+#   latency  every statx/newfstatat delayed by LATENCY_US using strace fault
+#            injection - a stand-in for NFS/FUSE where each getattr is a round trip.
+#            io_uring is skipped here: its statx calls never enter as syscalls,
+#            so the injected delay would not apply and the numbers would mislead.
+#
+# Uses ./zig-out/bin/lg unless LG is set. The latency scenario requires strace.
+
+set -euo pipefail
+
+ENTRIES="${1:-100000}"
+LATENCY_US="${2:-200}"
+RUNS="${RUNS:-5}"
+LG="${LG:-./zig-out/bin/lg}"
+
+if [ ! -x "$LG" ]; then
+    echo "error: $LG not found (run 'make release' first)" >&2
+    exit 1
+fi
+
+SCRATCH="$(mktemp -d)"
+trap 'rm -rf "$SCRATCH"' EXIT
+mkdir -p "$SCRATCH/dir"
+( cd "$SCRATCH/dir" && seq -f "file_%07g.txt" 1 "$ENTRIES" | xargs touch )
+
+# Median wall time in milliseconds of RUNS invocations of "$@"
+median_ms() {
+    local times=()
+    for _ in $(seq 1 "$RUNS"); do
+        local start end
+        start=$(date +%s%N)
+        "$@" >/dev/null 2>&1
+        end=$(date +%s%N)
+        times+=( $(( (end - start) / 1000000 )) )
+    done
+    printf '%s\n' "${times[@]}" | sort -n | awk '{ a[NR] = $1 } END { print a[int((NR + 1) / 2)] }'
+}
+
+# name | extra lg args
+CONFIGS=(
+    "fstatat|--stat-backend=serial"
+    "jobs=4|--stat-backend=threads --jobs 4"
+    "jobs=16|--stat-backend=threads --jobs 16"
+    "io_uring|--stat-backend=io_uring"
+    "auto|"
+)
+
+run_scenario() {
+    local scenario="$1"
+    shift
+    for config in "${CONFIGS[@]}"; do
+        local name="${config%%|*}"
+        local args="${config#*|}"
+        if [ "$scenario" = latency ] && [ "$name" = io_uring ]; then
+            continue
+        fi
+        # shellcheck disable=SC2086
+        local ms
+        ms=$(median_ms "$@" "$LG" -U --porcelain $args "$SCRATCH/dir")
+        printf '%-8s %-10s %8s ms\n' "$scenario" "$name" "$ms"
+    done
+}
+
+echo "entries: $ENTRIES, runs: $RUNS (median)"
+printf '%-8s %-10s %11s\n' "scenario" "backend" "wall"
+run_scenario local
+
+if command -v strace >/dev/null 2>&1; then
+    run_scenario latency strace -f -qq -o /dev/null \
+        -e trace=statx,newfstatat \
+        -e inject=statx,newfstatat:delay_enter="$LATENCY_US"
+else
+    echo "latency  (skipped: strace not found)"
+fi
@@ -0,0 +1,48 @@
+#!/usr/bin/env bash
+# Count syscalls per listed entry for lg.
+#
+# Usage: bench/syscalls.sh [ENTRIES] [LG_ARGS...]
+#   ENTRIES  number of files to create in the scratch directory (default 50000)
+#   LG_ARGS  extra flags passed to lg (default: none)
+#
+# Requires strace. Uses ./zig-out/bin/lg unless LG is set.
+# Output goes through a pipe so writes behave like `lg | less`.
+
+set -euo pipefail
+
+ENTRIES="${1:-50000}"
+shift || true
+LG="${LG:-./zig-out/bin/lg}"
+
+if ! command -v strace >/dev/null 2>&1; then
+    echo "error: strace not found" >&2
+    exit 1
+fi
+if [ ! -x "$LG" ]; then
+    echo "error: $LG not found (run 'make release' first)" >&2
+    exit 1
+fi
+
+SCRATCH="$(mktemp -d)"
+trap 'rm -rf "$SCRATCH"' EXIT
+
+mkdir -p "$SCRATCH/dir"
+( cd "$SCRATCH/dir" && seq -f "file_%07g.txt" 1 "$ENTRIES" | xargs touch )
+
+LOG="$SCRATCH/strace.log"
+strace -f -qq -o "$LOG" "$LG" "$@" "$SCRATCH/dir" | cat >/dev/null
+
+total=$(grep -cv '^+++\|^---' "$LOG" || true)
+writes=$(grep -cE '^[0-9]+ +(write|writev|pwrite64|pwritev|pwritev2)\(' "$LOG" || true)
+stats=$(grep -cE '^[0-9]+ +(newfstatat|fstatat64|statx|lstat|stat)\(' "$LOG" || true)
+
+echo "entries:            $ENTRIES"
+echo "lg args:            ${*:-(none)}"
+echo "total syscalls:     $total"
+echo "write syscalls:     $writes"
+echo "stat syscalls:      $stats"
+awk -v t="$total" -v w="$writes" -v s="$stats" -v n="$ENTRIES" 'BEGIN {
+    printf "syscalls / entry:   %.4f\n", t / n
+    printf "writes / entry:     %.6f\n", w / n
+    printf "stats / entry:      %.4f\n", s / n
+}'
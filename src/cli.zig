@@ -4,6 +4,7 @@
 
 const std = @import("std");
 const types = @import("types.zig");
+const pattern = @import("pattern.zig");
 
 /// Parse command-line arguments into a Config struct.
 ///
@@ -21,6 +22,12 @@ pub fn parseArgs(allocator: std.mem.Allocator) !types.Config {
     var positional = try std.ArrayList([]const u8).initCapacity(allocator, 0);
     defer positional.deinit(allocator);
 
+    // Exact names and glob patterns (from --match and positionals with * ? [)
+    var filters: std.ArrayList([]const u8) = .empty;
+    defer filters.deinit(allocator);
+    var patterns: std.ArrayList([]const u8) = .empty;
+    defer patterns.deinit(allocator);
+
     while (args.next()) |arg| {
         if (std.mem.startsWith(u8, arg, "-")) {
             // Check for long options first
@@ -32,14 +39,63 @@ pub fn parseArgs(allocator: std.mem.Allocator) !types.Config {
                 config.group_by_type = true;
             } else if (std.mem.eql(u8, arg, "--dir-sizes")) {
                 config.calc_dir_sizes = true;
+            } else if (std.mem.eql(u8, arg, "--size-cache")) {
+                config.calc_dir_sizes = true;
+                config.size_cache = true;
+            } else if (std.mem.startsWith(u8, arg, "--size-budget=")) {
+                config.calc_dir_sizes = true;
+                config.size_budget_ns = try parseDuration("--size-budget", arg["--size-budget=".len..]);
+            } else if (std.mem.startsWith(u8, arg, "--size-mode=")) {
+                config.size_mode = try parseMode(types.SizeMode, "--size-mode", arg["--size-mode=".len..]);
+            } else if (std.mem.eql(u8, arg, "--counts")) {
+                config.calc_dir_sizes = true;
+                config.show_counts = true;
             } else if (std.mem.eql(u8, arg, "--json")) {
                 config.output_format = .json;
+            } else if (std.mem.eql(u8, arg, "--ndjson")) {
+                config.output_format = .ndjson;
             } else if (std.mem.eql(u8, arg, "--porcelain")) {
                 config.output_format = .porcelain;
             } else if (std.mem.eql(u8, arg, "--branch")) {
                 config.show_branch = true;
+                config.git.branch = true; // Read from the same git status run
             } else if (std.mem.eql(u8, arg, "--legend")) {
                 config.show_legend = true;
+            } else if (std.mem.eql(u8, arg, "--timing")) {
+                config.show_timing = true;
+            } else if (std.mem.eql(u8, arg, "--jobs")) {
+                const value = args.next() orelse {
+                    std.debug.print("Option --jobs requires a value\n", .{});
+                    return error.InvalidArgument;
+                };
+                config.jobs = try parseJobs(value);
+            } else if (std.mem.startsWith(u8, arg, "--jobs=")) {
+                config.jobs = try parseJobs(arg["--jobs=".len..]);
+            } else if (std.mem.eql(u8, arg, "--git-no-renames")) {
+                config.git.renames = false;
+            } else if (std.mem.startsWith(u8, arg, "--git-untracked=")) {
+                config.git.untracked = try parseMode(types.GitOptions.UntrackedMode, "--git-untracked", arg["--git-untracked=".len..]);
+            } else if (std.mem.startsWith(u8, arg, "--git-timeout=")) {
+                config.git.timeout_ns = try parseDuration("--git-timeout", arg["--git-timeout=".len..]);
+            } else if (std.mem.startsWith(u8, arg, "--git-submodules=")) {
+                config.git.submodules = try parseMode(types.GitOptions.SubmoduleMode, "--git-submodules", arg["--git-submodules=".len..]);
+            } else if (std.mem.startsWith(u8, arg, "--stat-backend=")) {
+                const value = arg["--stat-backend=".len..];
+                config.stat_backend = std.meta.stringToEnum(types.StatBackend, value) orelse {
+                    std.debug.print("Invalid --stat-backend value: {s}\n", .{value});
+                    std.debug.print("Expected one of: auto, serial, threads, io_uring\n", .{});
+                    return error.InvalidArgument;
+                };
+            } else if (std.mem.eql(u8, arg, "--match")) {
+                const value = args.next() orelse {
+                    std.debug.print("Option --match requires a pattern\n", .{});
+                    return error.InvalidArgument;
+                };
+                try patterns.append(allocator, value);
+            } else if (std.mem.startsWith(u8, arg, "--match=")) {
+                try patterns.append(allocator, arg["--match=".len..]);
+            } else if (std.mem.eql(u8, arg, "--ignore-case")) {
+                config.ignore_case = true;
             } else if (std.mem.eql(u8, arg, "--help")) {
                 try printHelp();
                 std.process.exit(0);
@@ -112,6 +168,8 @@ pub fn parseArgs(allocator: std.mem.Allocator) !types.Config {
     // 2. Multiple args → ALL are file filters
     //    - If args contain paths (like src/foo.zig), extract common dir and use basenames
     //    - This handles `lg src/*.zig` correctly
+    // 3. Names with glob characters (quoted, e.g. lg '*.zig') become patterns,
+    //    matched in-process instead of by the shell
     if (positional.items.len == 1) {
         const first = positional.items[0];
         // Check if single arg is a directory
@@ -123,12 +181,10 @@ pub fn parseArgs(allocator: std.mem.Allocator) !types.Config {
             if (std.mem.indexOf(u8, first, "/")) |_| {
                 // Has path: use dirname as dir_path, basename as filter
                 config.dir_path = std.fs.path.dirname(first) orelse ".";
-                var basenames = try std.ArrayList([]const u8).initCapacity(allocator, 1);
-                try basenames.append(allocator, std.fs.path.basename(first));
-                config.file_filters = try basenames.toOwnedSlice(allocator);
+                try addNameFilter(allocator, &filters, &patterns, std.fs.path.basename(first));
             } else {
                 // No path: filter in current directory
-                config.file_filters = try allocator.dupe([]const u8, positional.items);
+                try addNameFilter(allocator, &filters, &patterns, first);
             }
         }
     } else if (positional.items.len > 1) {
@@ -140,20 +196,84 @@ pub fn parseArgs(allocator: std.mem.Allocator) !types.Config {
             config.dir_path = common_dir;
 
             // Convert all paths to basenames
-            var basenames = try std.ArrayList([]const u8).initCapacity(allocator, positional.items.len);
+            try filters.ensureUnusedCapacity(allocator, positional.items.len);
             for (positional.items) |item| {
-                try basenames.append(allocator, std.fs.path.basename(item));
+                try addNameFilter(allocator, &filters, &patterns, std.fs.path.basename(item));
             }
-            config.file_filters = try basenames.toOwnedSlice(allocator);
         } else {
             // No paths: file filters in current directory
-            config.file_filters = try allocator.dupe([]const u8, positional.items);
+            try filters.ensureUnusedCapacity(allocator, positional.items.len);
+            for (positional.items) |item| {
+                try addNameFilter(allocator, &filters, &patterns, item);
+            }
         }
     }
 
+    if (filters.items.len > 0) config.file_filters = try filters.toOwnedSlice(allocator);
+    if (patterns.items.len > 0) config.patterns = try patterns.toOwnedSlice(allocator);
+
     return config;
 }
 
+/// Add a positional name to the exact-name filters and, if it has glob
+/// characters, to the patterns too: a literal file such as "[id].tsx"
+/// still matches by name when the pattern doesn't.
+fn addNameFilter(
+    allocator: std.mem.Allocator,
+    filters: *std.ArrayList([]const u8),
+    patterns: *std.ArrayList([]const u8),
+    name: []const u8,
+) !void {
+    try filters.append(allocator, name);
+    if (pattern.hasGlobMeta(name)) try patterns.append(allocator, name);
+}
+
+/// Parse --jobs value: a positive thread count.
+fn parseJobs(value: []const u8) !usize {
+    const jobs = std.fmt.parseInt(usize, value, 10) catch {
+        std.debug.print("Invalid --jobs value: {s}\n", .{value});
+        return error.InvalidArgument;
+    };
+    if (jobs == 0) {
+        std.debug.print("Invalid --jobs value: must be at least 1\n", .{});
+        return error.InvalidArgument;
+    }
+    return jobs;
+}
+
+/// "150ms", "2s" or a bare number of milliseconds, in nanoseconds.
+fn parseDuration(comptime flag: []const u8, value: []const u8) !u64 {
+    const units = [_]struct { suffix: []const u8, ns: u64 }{
+        .{ .suffix = "ms", .ns = std.time.ns_per_ms },
+        .{ .suffix = "s", .ns = std.time.ns_per_s },
+        .{ .suffix = "", .ns = std.time.ns_per_ms },
+    };
+    for (units) |unit| {
+        if (!std.mem.endsWith(u8, value, unit.suffix)) continue;
+        const number = value[0 .. value.len - unit.suffix.len];
+        const count = std.fmt.parseInt(u64, number, 10) catch break;
+        return std.math.mul(u64, count, unit.ns) catch break;
+    }
+    std.debug.print("Invalid " ++ flag ++ " value: {s} (expected e.g. 150ms or 2s)\n", .{value});
+    return error.InvalidArgument;
+}
+
+fn parseMode(comptime Mode: type, comptime flag: []const u8, value: []const u8) !Mode {
+    return std.meta.stringToEnum(Mode, value) orelse {
+        std.debug.print("Invalid " ++ flag ++ " value: {s}\n", .{value});
+        std.debug.print("Expected one of: {s}\n", .{comptime modeNames(Mode)});
+        return error.InvalidArgument;
+    };
+}
+
+fn modeNames(comptime Mode: type) []const u8 {
+    var names: []const u8 = "";
+    for (std.meta.fieldNames(Mode), 0..) |name, i| {
+        names = names ++ (if (i > 0) ", " else "") ++ name;
+    }
+    return names;
+}
+
 /// Print help message to stdout.
 fn printHelp() !void {
     const stdout = std.fs.File.stdout();
@@ -174,19 +294,39 @@ fn printHelp() !void {
         \\  -i                 Show inode numbers
         \\  -t, --type         Group by file type with blank lines between groups
         \\  -d, --dir-sizes    Calculate directory sizes (may be slow)
+        \\  --size-cache       -d, reusing sums of directories unchanged since the last
+        \\                     run (~/.cache/lg; misses files rewritten in place)
+        \\  --size-budget=T    -d, but stop walking after T (e.g. 500ms, 2s) and mark
+        \\                     unfinished sums with ≥ (on a terminal, rows fill in as
+        \\                     each subtree finishes either way)
+        \\  --size-mode=M      Size column: apparent (st_size) or disk (allocated blocks);
+        \\                     default shows st_size for files, disk usage for -d sums
+        \\  --counts           -d, plus columns counting the files and directories
+        \\                     under each directory
         \\  -l                 Standard detail level (permissions, owner)
         \\  -ll                Full detail level (octal mode, group)
         \\  -F                 Append file type indicators (/ for dirs, * for exec, @ for links)
         \\  -p                 Append / to directory names
         \\  -1                 One entry per line (simple output)
-        \\  -U                 Unsorted (directory order, faster)
+        \\  -U                 Unsorted (directory order, streamed as it is read)
         \\  -o                 Long format, omit group info
         \\  -g                 Long format, omit owner info
         \\  -X                 Sort by file extension
         \\  --json             Output in JSON format
+        \\  --ndjson           One JSON object per line (streams with -U)
         \\  --porcelain        Machine-readable output
-        \\  --branch           Show current git branch
+        \\  --branch           Show git branch, upstream and ahead/behind
         \\  --legend           Show git status legend
+        \\  --match PATTERN    Only list names matching a glob (* ? [a-z]); repeatable
+        \\  --ignore-case      Case-insensitive --match and quoted patterns
+        \\  --jobs N           Stat and walk -d with N threads (default: auto)
+        \\  --stat-backend=B   Metadata backend: auto, serial, threads, io_uring
+        \\  --timing           Print phase timings (git vs listing overlap) to stderr
+        \\  --git-no-renames   Skip git rename detection (faster on large change sets)
+        \\  --git-untracked=M  Untracked files: no, normal, all (default: git config)
+        \\  --git-submodules=M Ignore submodule changes: none, untracked, dirty, all
+        \\  --git-timeout=T    Give git at most T (e.g. 150ms, 2s); on expiry show [~]
+        \\                     and exit with status 3
         \\  -h, --help         Show this help message
         \\
         \\Legacy ls Compatibility (capital letters):
@@ -201,6 +341,7 @@ fn printHelp() !void {
         \\  [●] Staged changes    [○] Unstaged changes
         \\  [?] Untracked files   [!] Ignored files
         \\  [·] Clean/tracked (green dot)
+        \\  [~] Unknown (git stopped by --git-timeout)
         \\
         \\Examples:
         \\  lg                 # List current directory
@@ -213,6 +354,8 @@ fn printHelp() !void {
         \\  lg -U              # Unsorted (fast, natural order)
         \\  lg -X              # Sort by extension
         \\  lg src/*.zig       # List specific files
+        \\  lg 'src/*.zig'     # Same, matched in-process (no argv limit)
+        \\  lg --match 'test_*' --ignore-case
         \\
     );
     try writer.flush();
@@ -375,7 +518,53 @@ test "output format defaults to normal" {
     try std.testing.expectEqual(types.OutputFormat.normal, config.output_format);
 }
 
+test "addNameFilter - glob names become patterns and stay exact names" {
+    const allocator = std.testing.allocator;
+    var filters: std.ArrayList([]const u8) = .empty;
+    defer filters.deinit(allocator);
+    var patterns: std.ArrayList([]const u8) = .empty;
+    defer patterns.deinit(allocator);
+
+    for ([_][]const u8{ "main.zig", "*.zig", "[id].tsx", "README.md" }) |name| {
+        try addNameFilter(allocator, &filters, &patterns, name);
+    }
+
+    try std.testing.expectEqual(@as(usize, 4), filters.items.len);
+    try std.testing.expectEqualStrings("[id].tsx", filters.items[2]);
+    try std.testing.expectEqual(@as(usize, 2), patterns.items.len);
+    try std.testing.expectEqualStrings("*.zig", patterns.items[0]);
+    try std.testing.expectEqualStrings("[id].tsx", patterns.items[1]);
+}
+
+test "parseJobs - accepts positive counts" {
+    try std.testing.expectEqual(@as(usize, 1), try parseJobs("1"));
+    try std.testing.expectEqual(@as(usize, 16), try parseJobs("16"));
+}
+
+test "parseJobs - rejects zero and garbage" {
+    try std.testing.expectError(error.InvalidArgument, parseJobs("0"));
+    try std.testing.expectError(error.InvalidArgument, parseJobs("-2"));
+    try std.testing.expectError(error.InvalidArgument, parseJobs("many"));
+}
+
 test "file_filters defaults to null" {
     const config = types.Config.default();
     try std.testing.expect(config.file_filters == null);
 }
+
+test "parseMode - git tuning and size mode values" {
+    try std.testing.expectEqual(types.GitOptions.UntrackedMode.no, try parseMode(types.GitOptions.UntrackedMode, "--git-untracked", "no"));
+    try std.testing.expectEqual(types.GitOptions.SubmoduleMode.dirty, try parseMode(types.GitOptions.SubmoduleMode, "--git-submodules", "dirty"));
+    try std.testing.expectError(error.InvalidArgument, parseMode(types.GitOptions.UntrackedMode, "--git-untracked", "some"));
+    try std.testing.expectEqualStrings("none, untracked, dirty, all", comptime modeNames(types.GitOptions.SubmoduleMode));
+    try std.testing.expectEqual(types.SizeMode.apparent, try parseMode(types.SizeMode, "--size-mode", "apparent"));
+    try std.testing.expectError(error.InvalidArgument, parseMode(types.SizeMode, "--size-mode", "blocks"));
+}
+
+test "parseDuration - milliseconds, seconds and bare numbers" {
+    try std.testing.expectEqual(@as(u64, 150 * std.time.ns_per_ms), try parseDuration("--git-timeout", "150ms"));
+    try std.testing.expectEqual(@as(u64, 2 * std.time.ns_per_s), try parseDuration("--git-timeout", "2s"));
+    try std.testing.expectEqual(@as(u64, 40 * std.time.ns_per_ms), try parseDuration("--git-timeout", "40"));
+    try std.testing.expectError(error.InvalidArgument, parseDuration("--git-timeout", "fast"));
+    try std.testing.expectError(error.InvalidArgument, parseDuration("--git-timeout", "1.5s"));
+}
@@ -34,6 +34,7 @@ pub const git_staged_copied = "\x1b[38;5;73m"; // Muted cyan
 pub const git_unstaged_copied = "\x1b[38;5;66m"; // Dimmed cyan
 pub const git_untracked = "\x1b[38;5;245m"; // Light gray
 pub const git_ignored = "\x1b[38;5;240m"; // Dark gray
+pub const git_unknown = "\x1b[38;5;240m"; // Dark gray: no status, not a claim about the file
 pub const git_clean = "\x1b[38;5;34m"; // Muted green (same as staged_added)
 
 // File type colors
@@ -61,6 +62,7 @@ pub fn getColor(name: []const u8) []const u8 {
     if (std.mem.eql(u8, name, "git_unstaged_copied")) return git_unstaged_copied;
     if (std.mem.eql(u8, name, "git_untracked")) return git_untracked;
     if (std.mem.eql(u8, name, "git_ignored")) return git_ignored;
+    if (std.mem.eql(u8, name, "git_unknown")) return git_unknown;
     if (std.mem.eql(u8, name, "git_clean")) return git_clean;
     if (std.mem.eql(u8, name, "symlink")) return symlink;
     if (std.mem.eql(u8, name, "directory")) return directory;
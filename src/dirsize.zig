@@ -0,0 +1,762 @@
+//! Recursive directory sizes for -d, walked in-process.
+//!
+//! One walk of the listed directory replaces `du -sk` with every child on
+//! its command line: no argv limit, no kilobyte rounding, no dependency on
+//! du, and the walk runs on several threads. Each stat feeds every figure
+//! at once (see Usage): st_blocks in bytes like du, st_size like
+//! `du --apparent-size`, and file and directory counts. Symlinks are
+//! never followed and a hard-linked inode is counted once per walk, in
+//! whichever subtree reaches it first.
+//!
+//! The unit of work is one directory. A worker reads it whole with
+//! getdents, fstatat()s each entry, then pushes its subdirectories onto
+//! its own deque. Owners pop the newest task (depth-first, which keeps few
+//! directories open); idle workers steal the oldest task from another
+//! deque, which tends to be a large subtree near the top. The listed
+//! directory's own subdirectories are dealt out biggest first, so the
+//! slowest subtrees start at once.
+//!
+//! Measure runs the walk on its own threads: callers can read each
+//! child's sum as soon as its subtree is done, and stop the walk early,
+//! leaving the unfinished sums as lower bounds.
+
+const std = @import("std");
+const types = @import("types.zig");
+const filesystem = @import("filesystem.zig");
+const sizecache = @import("sizecache.zig");
+
+/// Walk state is shared by all workers, so it can't use the caller's
+/// (usually arena, not thread-safe) allocator
+const allocator = std.heap.smp_allocator;
+
+const no_root = std.math.maxInt(u32);
+const hardlink_shards = 16;
+const max_workers = 64;
+
+pub const State = types.FileInfo.SizeState;
+
+/// What the walk counts under a directory, the directory itself included
+/// in the sizes but not in `dirs`.
+pub const Usage = struct {
+    disk: u64 = 0, // st_blocks in bytes, what `du -s` shows
+    apparent: u64 = 0, // st_size, what `du -s --apparent-size` shows
+    files: u64 = 0, // Non-directory entries (hard links count per name)
+    dirs: u64 = 0, // Subdirectories at any depth
+};
+
+/// Usage of each named child of `dir` and of `dir` itself.
+/// `usage[i]` receives the counts under `dir/names[i]`; names that aren't
+/// directories keep zeros. Returns the total for `dir`, hidden entries
+/// included: what `du -sk dir` counts. Unreadable subtrees are skipped,
+/// like du skips them with a warning. With a `cache`, unchanged
+/// directories are taken from it and the directories counted are written
+/// back.
+pub fn measure(dir: std.fs.Dir, names: []const []const u8, usage: []Usage, workers: usize, cache: ?*const sizecache.SizeCache) !Usage {
+    std.debug.assert(names.len == usage.len);
+
+    const m = try Measure.start(dir, names, workers, cache);
+    defer m.destroy();
+    try m.join();
+    for (usage, 0..) |*out, i| out.* = m.usage(i);
+    return m.total();
+}
+
+/// A walk in progress on its own threads. `names` and `cache` must outlive
+/// it; the state of each child is readable at any time.
+pub const Measure = struct {
+    walk: Walk,
+    threads: [max_workers]std.Thread = undefined,
+    spawned: usize = 0,
+
+    /// Scan `dir` itself on this thread, then hand its subdirectories to
+    /// the workers and return.
+    pub fn start(dir: std.fs.Dir, names: []const []const u8, workers: usize, cache: ?*const sizecache.SizeCache) !*Measure {
+        const self = try allocator.create(Measure);
+        errdefer allocator.destroy(self);
+        self.* = .{ .walk = try Walk.init(names, workers) };
+        errdefer self.walk.deinit();
+        self.walk.cache = cache;
+
+        // The listed directory is scanned here, from the start through a fd of
+        // its own; its subdirectories go to the pool
+        const fd = try std.posix.openat(dir.fd, ".", .{ .ACCMODE = .RDONLY, .DIRECTORY = true, .CLOEXEC = true }, 0);
+        self.walk.scan(&self.walk.workers[0], fd, no_root);
+        if (self.walk.pending.load(.acquire) == 0) {
+            self.walk.ended.set();
+            return self;
+        }
+
+        for (0..self.walk.workers.len) |id| {
+            // Fewer threads just means the others take the slack
+            self.threads[self.spawned] = std.Thread.spawn(.{ .stack_size = 256 * 1024 }, Walk.work, .{ &self.walk, id }) catch break;
+            self.spawned += 1;
+        }
+        if (self.spawned == 0) self.walk.work(0); // No threads at all: walk here
+        return self;
+    }
+
+    /// Wait up to `timeout_ns` for a child to finish (or the walk to end).
+    pub fn waitChange(self: *Measure, timeout_ns: u64) void {
+        self.walk.changed.timedWait(timeout_ns) catch {};
+        self.walk.changed.reset();
+    }
+
+    /// Wait up to `timeout_ns` for the whole walk. True once it has ended.
+    pub fn waitEnd(self: *Measure, timeout_ns: u64) bool {
+        self.walk.ended.timedWait(timeout_ns) catch return false;
+        return true;
+    }
+
+    pub fn running(self: *const Measure) bool {
+        return !self.walk.ended.isSet();
+    }
+
+    /// Skip every directory not yet opened. Sums read afterwards are lower
+    /// bounds wherever something was skipped (State.partial).
+    pub fn stop(self: *Measure) void {
+        self.walk.stopped.store(true, .monotonic);
+    }
+
+    /// Wait for the walk to end, then write the size cache.
+    pub fn join(self: *Measure) !void {
+        self.walk.ended.wait();
+        for (self.threads[0..self.spawned]) |thread| thread.join();
+        self.spawned = 0;
+        if (self.walk.failed.load(.monotonic)) return error.OutOfMemory;
+        if (self.walk.cache) |c| self.walk.saveCache(c);
+    }
+
+    pub fn destroy(self: *Measure) void {
+        if (self.spawned > 0) {
+            self.stop();
+            self.join() catch {};
+        }
+        self.walk.deinit();
+        allocator.destroy(self);
+    }
+
+    /// Counted so far under `names[i]`.
+    pub fn usage(self: *const Measure, i: usize) Usage {
+        return self.walk.usage[i].load();
+    }
+
+    pub fn state(self: *const Measure, i: usize) State {
+        if (self.walk.outstanding[i].load(.acquire) > 0) return .pending;
+        return if (self.walk.cut[i].load(.monotonic)) .partial else .exact;
+    }
+
+    /// Counted so far under the listed directory.
+    pub fn total(self: *const Measure) Usage {
+        return self.walk.total.load();
+    }
+
+    pub fn totalState(self: *const Measure) State {
+        if (self.running()) return .pending;
+        return if (self.walk.cut_any.load(.monotonic)) .partial else .exact;
+    }
+};
+
+fn blockBytes(st: std.posix.Stat) u64 {
+    const blocks: u64 = @intCast(@max(st.blocks, 0));
+    return std.math.mul(u64, blocks, 512) catch std.math.maxInt(u64);
+}
+
+fn sizeBytes(st: std.posix.Stat) u64 {
+    return @intCast(@max(st.size, 0));
+}
+
+/// A guess at how big the subtree under `name` is, to start big ones
+/// first: the directory's entry table plus a block per subdirectory.
+fn weight(fd: std.posix.fd_t, name: []const u8) u64 {
+    const st = std.posix.fstatat(fd, name, std.posix.AT.SYMLINK_NOFOLLOW) catch return 0;
+    const subdirs: u64 = @max(st.nlink, 2) - 2;
+    return sizeBytes(st) +| subdirs *| 4096;
+}
+
+/// Usage shared between workers. Each field is its own atomic, so a read
+/// mid-walk may mix figures from before and after one directory.
+const Counters = struct {
+    disk: std.atomic.Value(u64) = .init(0),
+    apparent: std.atomic.Value(u64) = .init(0),
+    files: std.atomic.Value(u64) = .init(0),
+    dirs: std.atomic.Value(u64) = .init(0),
+
+    fn add(self: *Counters, usage: Usage) void {
+        inline for (@typeInfo(Usage).@"struct".fields) |field| {
+            const value = @field(usage, field.name);
+            if (value != 0) _ = @field(self, field.name).fetchAdd(value, .monotonic);
+        }
+    }
+
+    fn load(self: *const Counters) Usage {
+        var usage: Usage = .{};
+        inline for (@typeInfo(Usage).@"struct".fields) |field| {
+            @field(usage, field.name) = @field(self, field.name).load(.monotonic);
+        }
+        return usage;
+    }
+};
+
+/// An open directory whose subdirectories are queued. Freed when the last
+/// of them has been opened.
+const Handle = struct {
+    fd: std.posix.fd_t,
+    refs: std.atomic.Value(u32),
+    names: []u8, // NUL-separated subdirectory names
+
+    fn release(self: *Handle) void {
+        if (self.refs.fetchSub(1, .acq_rel) != 1) return;
+        std.posix.close(self.fd);
+        allocator.free(self.names);
+        allocator.destroy(self);
+    }
+};
+
+/// A subdirectory to scan: `name` inside `parent`, counted toward `root`.
+const Task = struct {
+    parent: *Handle,
+    name: [:0]const u8,
+    root: u32,
+};
+
+/// One worker's tasks. The owner pushes and pops at the back, thieves take
+/// from the front.
+const Deque = struct {
+    mutex: std.Thread.Mutex = .{},
+    tasks: std.ArrayList(Task) = .empty,
+    head: usize = 0,
+
+    fn push(self: *Deque, tasks: []const Task) !void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        try self.tasks.appendSlice(allocator, tasks);
+    }
+
+    fn reserve(self: *Deque, count: usize) !void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        try self.tasks.ensureUnusedCapacity(allocator, count);
+    }
+
+    fn pushAssumeCapacity(self: *Deque, task: Task) void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        self.tasks.appendAssumeCapacity(task);
+    }
+
+    fn pop(self: *Deque) ?Task {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        if (self.tasks.items.len == self.head) return null;
+        const task = self.tasks.pop().?;
+        self.compact();
+        return task;
+    }
+
+    fn steal(self: *Deque) ?Task {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        if (self.tasks.items.len == self.head) return null;
+        const task = self.tasks.items[self.head];
+        self.head += 1;
+        self.compact();
+        return task;
+    }
+
+    fn compact(self: *Deque) void {
+        if (self.head == self.tasks.items.len) {
+            self.tasks.clearRetainingCapacity();
+            self.head = 0;
+        }
+    }
+};
+
+const Worker = struct {
+    deque: Deque = .{},
+    iter: filesystem.DirIterator = undefined, // 32KB getdents buffer, reused
+    subdirs: std.ArrayList(u8) = .empty, // Names gathered by the current scan
+    tasks: std.ArrayList(Task) = .empty,
+    weights: std.ArrayList(u64) = .empty, // Parallel to tasks, listed directory only
+    fresh: std.ArrayList(sizecache.Record) = .empty, // For the size cache
+};
+
+/// Inodes with more than one link, seen so far in this walk
+const HardLinks = struct {
+    const Key = struct { dev: u64, ino: u64 };
+
+    shards: [hardlink_shards]struct {
+        mutex: std.Thread.Mutex = .{},
+        seen: std.AutoHashMapUnmanaged(Key, void) = .empty,
+    } = @splat(.{}),
+
+    /// True the first time an inode is offered
+    fn first(self: *HardLinks, st: std.posix.Stat) !bool {
+        const key = Key{ .dev = @intCast(st.dev), .ino = @intCast(st.ino) };
+        const shard = &self.shards[key.ino % hardlink_shards];
+        shard.mutex.lock();
+        defer shard.mutex.unlock();
+        const gop = try shard.seen.getOrPut(allocator, key);
+        return !gop.found_existing;
+    }
+
+    fn deinit(self: *HardLinks) void {
+        for (&self.shards) |*shard| shard.seen.deinit(allocator);
+    }
+};
+
+const Walk = struct {
+    workers: []Worker,
+    roots: std.StringHashMapUnmanaged(u32) = .empty, // Child name -> index in usage
+    usage: []Counters,
+    outstanding: []std.atomic.Value(u32), // Per root: tasks queued or running
+    cut: []std.atomic.Value(bool), // Per root: a task was skipped by stop()
+    total: Counters = .{},
+    pending: std.atomic.Value(usize) = .init(0), // Tasks queued or running
+    hardlinks: HardLinks = .{},
+    cache: ?*const sizecache.SizeCache = null,
+    failed: std.atomic.Value(bool) = .init(false),
+    stopped: std.atomic.Value(bool) = .init(false),
+    cut_any: std.atomic.Value(bool) = .init(false),
+    changed: std.Thread.ResetEvent = .{}, // A root finished
+    ended: std.Thread.ResetEvent = .{}, // Nothing left pending
+
+    fn init(names: []const []const u8, worker_count: usize) !Walk {
+        const workers = try allocator.alloc(Worker, std.math.clamp(worker_count, 1, max_workers));
+        errdefer allocator.free(workers);
+        for (workers) |*worker| worker.* = .{};
+        const usage = try allocator.alloc(Counters, names.len);
+        errdefer allocator.free(usage);
+        @memset(usage, .{});
+        const outstanding = try allocator.alloc(std.atomic.Value(u32), names.len);
+        errdefer allocator.free(outstanding);
+        @memset(outstanding, .init(0));
+        const cut = try allocator.alloc(std.atomic.Value(bool), names.len);
+        errdefer allocator.free(cut);
+        @memset(cut, .init(false));
+
+        var self = Walk{ .workers = workers, .usage = usage, .outstanding = outstanding, .cut = cut };
+        errdefer self.roots.deinit(allocator);
+        try self.roots.ensureTotalCapacity(allocator, @intCast(names.len));
+        for (names, 0..) |name, i| self.roots.putAssumeCapacity(name, @intCast(i));
+        return self;
+    }
+
+    fn deinit(self: *Walk) void {
+        for (self.workers) |*worker| {
+            worker.deque.tasks.deinit(allocator);
+            worker.subdirs.deinit(allocator);
+            worker.tasks.deinit(allocator);
+            worker.weights.deinit(allocator);
+            worker.fresh.deinit(allocator);
+        }
+        allocator.free(self.workers);
+        allocator.free(self.usage);
+        allocator.free(self.outstanding);
+        allocator.free(self.cut);
+        self.roots.deinit(allocator);
+        self.hardlinks.deinit();
+    }
+
+    fn work(self: *Walk, id: usize) void {
+        const me = &self.workers[id];
+        var idle: u32 = 0;
+        while (true) {
+            const task = me.deque.pop() orelse self.steal(id) orelse {
+                if (self.pending.load(.acquire) == 0) return;
+                // Someone is still scanning and may publish more
+                idle += 1;
+                if (idle < 64) std.Thread.yield() catch {} else std.Thread.sleep(50 * std.time.ns_per_us);
+                continue;
+            };
+            idle = 0;
+            self.runTask(me, task);
+            if (task.root != no_root) self.settle(task.root);
+            if (self.pending.fetchSub(1, .acq_rel) == 1) {
+                self.ended.set();
+                self.changed.set();
+            }
+        }
+    }
+
+    fn steal(self: *Walk, id: usize) ?Task {
+        for (1..self.workers.len) |offset| {
+            const victim = &self.workers[(id + offset) % self.workers.len];
+            if (victim.deque.steal()) |task| return task;
+        }
+        return null;
+    }
+
+    fn runTask(self: *Walk, me: *Worker, task: Task) void {
+        defer task.parent.release();
+        if (self.stopped.load(.monotonic)) {
+            if (task.root != no_root) self.cut[task.root].store(true, .monotonic);
+            self.cut_any.store(true, .monotonic);
+            return;
+        }
+        const fd = std.posix.openat(task.parent.fd, task.name, .{
+            .ACCMODE = .RDONLY,
+            .DIRECTORY = true,
+            .NOFOLLOW = true,
+            .CLOEXEC = true,
+        }, 0) catch return; // Removed or unreadable: skip the subtree
+        self.scan(me, fd, task.root);
+    }
+
+    /// Count the open directory `fd` (itself and its non-directory
+    /// entries) and queue its subdirectories. Takes ownership of `fd`. With
+    /// `root` == no_root (the listed directory) each subdirectory picks its
+    /// own root by name. A valid cache record stands in for the per-entry
+    /// stats; the directory is still read to find its subdirectories,
+    /// unless the record says it has none.
+    fn scan(self: *Walk, me: *Worker, fd: std.posix.fd_t, root: u32) void {
+        var keep_fd = false;
+        defer if (!keep_fd) std.posix.close(fd);
+        me.subdirs.clearRetainingCapacity();
+        me.tasks.clearRetainingCapacity();
+        me.weights.clearRetainingCapacity();
+
+        const dir_st = std.posix.fstat(fd) catch return;
+        const cached = if (self.cache) |cache| cache.lookup(dir_st) else null;
+
+        // The non-directory entries, as the cache records them
+        var bytes: u64 = 0;
+        var apparent: u64 = 0;
+        var files: u32 = 0;
+        var linked = false; // Holds a hard link: its sum depends on the walk
+        if (cached) |record| {
+            bytes = record.bytes;
+            apparent = record.apparent;
+            files = record.files;
+        }
+
+        if (cached == null or cached.?.subdirs > 0) {
+            me.iter = .init(.{ .fd = fd });
+            while (me.iter.next() catch null) |entry| {
+                if (std.mem.eql(u8, entry.name, ".") or std.mem.eql(u8, entry.name, "..")) continue;
+                var is_dir = entry.kind == .directory;
+                if (entry.kind == .unknown or (!is_dir and cached == null)) {
+                    const st = std.posix.fstatat(fd, entry.name, std.posix.AT.SYMLINK_NOFOLLOW) catch continue;
+                    is_dir = std.posix.S.ISDIR(st.mode);
+                    if (!is_dir and cached == null) {
+                        files +|= 1;
+                        if (st.nlink > 1) {
+                            linked = true;
+                            const first = self.hardlinks.first(st) catch return self.fail();
+                            if (!first) continue;
+                        }
+                        bytes += blockBytes(st);
+                        apparent += sizeBytes(st);
+                    }
+                }
+                if (!is_dir) continue;
+
+                // Subdirectories count themselves when scanned
+                const entry_root = if (root == no_root) self.roots.get(entry.name) orelse no_root else root;
+                me.subdirs.appendSlice(allocator, entry.name) catch return self.fail();
+                me.subdirs.append(allocator, 0) catch return self.fail();
+                me.tasks.append(allocator, .{ .parent = undefined, .name = undefined, .root = entry_root }) catch return self.fail();
+                if (root == no_root) {
+                    const guess = if (entry_root == no_root) 0 else weight(fd, entry.name);
+                    me.weights.append(allocator, guess) catch return self.fail();
+                }
+            }
+        }
+        // Flushed toward `root` once per directory
+        self.add(root, .{
+            .disk = blockBytes(dir_st) +| bytes,
+            .apparent = sizeBytes(dir_st) +| apparent,
+            .files = files,
+            .dirs = me.tasks.items.len,
+        });
+
+        if (self.cache) |cache| {
+            const subdirs = std.math.cast(u32, me.tasks.items.len) orelse std.math.maxInt(u32);
+            const record = if (linked) null else cached orelse cache.record(dir_st, bytes, apparent, files, subdirs);
+            if (record) |r| me.fresh.append(allocator, r) catch return self.fail();
+        }
+        if (me.tasks.items.len == 0) return;
+
+        // Publish the subdirectories: one handle keeps fd open for all of them
+        const handle = allocator.create(Handle) catch return self.fail();
+        handle.* = .{
+            .fd = fd,
+            .refs = .init(@intCast(me.tasks.items.len)),
+            .names = allocator.dupe(u8, me.subdirs.items) catch {
+                allocator.destroy(handle);
+                return self.fail();
+            },
+        };
+        keep_fd = true;
+        var offset: usize = 0;
+        for (me.tasks.items) |*task| {
+            const len = std.mem.indexOfScalarPos(u8, handle.names, offset, 0).? - offset;
+            task.parent = handle;
+            task.name = handle.names[offset..][0..len :0];
+            offset += len + 1;
+        }
+        _ = self.pending.fetchAdd(me.tasks.items.len, .acq_rel);
+        for (me.tasks.items) |task| {
+            if (task.root != no_root) _ = self.outstanding[task.root].fetchAdd(1, .acq_rel);
+        }
+        const pushed = if (root == no_root) self.deal(me) else me.deque.push(me.tasks.items);
+        pushed catch {
+            _ = self.pending.fetchSub(me.tasks.items.len, .acq_rel);
+            for (me.tasks.items) |task| {
+                if (task.root != no_root) self.settle(task.root);
+                handle.release();
+            }
+            return self.fail();
+        };
+    }
+
+    /// Spread the listed directory's subdirectories over the workers,
+    /// biggest first: each owner pops its largest, so the subtrees that
+    /// take longest start at once instead of behind a queue of small ones.
+    fn deal(self: *Walk, me: *Worker) !void {
+        const tasks = me.tasks.items;
+        std.sort.pdqContext(0, tasks.len, ByWeight{ .tasks = tasks, .weights = me.weights.items });
+        const n = self.workers.len;
+        for (self.workers) |*worker| try worker.deque.reserve((tasks.len + n - 1) / n);
+        // Smallest pushed first: the back of each deque is its biggest task
+        var i = tasks.len;
+        while (i > 0) {
+            i -= 1;
+            self.workers[i % n].deque.pushAssumeCapacity(tasks[i]);
+        }
+    }
+
+    /// One task less for `root`; wake the caller when it was the last
+    fn settle(self: *Walk, root: u32) void {
+        if (self.outstanding[root].fetchSub(1, .acq_rel) == 1) self.changed.set();
+    }
+
+    fn saveCache(self: *Walk, cache: *const sizecache.SizeCache) void {
+        var fresh: std.ArrayList(sizecache.Record) = .empty;
+        defer fresh.deinit(allocator);
+        for (self.workers) |worker| fresh.appendSlice(allocator, worker.fresh.items) catch return;
+        cache.save(allocator, fresh.items);
+    }
+
+    /// Count toward `root` (if any) and the listed directory's total
+    fn add(self: *Walk, root: u32, usage: Usage) void {
+        if (root != no_root) self.usage[root].add(usage);
+        self.total.add(usage);
+    }
+
+    /// Heaviest first, for deal()
+    const ByWeight = struct {
+        tasks: []Task,
+        weights: []u64,
+
+        pub fn lessThan(ctx: ByWeight, a: usize, b: usize) bool {
+            return ctx.weights[a] > ctx.weights[b];
+        }
+
+        pub fn swap(ctx: ByWeight, a: usize, b: usize) void {
+            std.mem.swap(Task, &ctx.tasks[a], &ctx.tasks[b]);
+            std.mem.swap(u64, &ctx.weights[a], &ctx.weights[b]);
+        }
+    };
+
+    /// Out of memory mid-walk: the sums are incomplete
+    fn fail(self: *Walk) void {
+        self.failed.store(true, .monotonic);
+    }
+};
+
+// ═══════════════════════════════════════════════════════════
+// TESTS
+// ═══════════════════════════════════════════════════════════
+
+fn testFile(dir: std.fs.Dir, path: []const u8, len: usize) !void {
+    const file = try dir.createFile(path, .{});
+    defer file.close();
+    const data: [4096]u8 = @splat('x');
+    var left = len;
+    while (left > 0) : (left -= @min(left, data.len)) try file.writeAll(data[0..@min(left, data.len)]);
+    try file.sync(); // Allocate blocks now (delayed allocation reports 0)
+}
+
+fn testBlocks(dir: std.fs.Dir, path: []const u8) !u64 {
+    return blockBytes(try std.posix.fstatat(dir.fd, path, std.posix.AT.SYMLINK_NOFOLLOW));
+}
+
+fn testApparent(dir: std.fs.Dir, paths: []const []const u8) !u64 {
+    var sum: u64 = 0;
+    for (paths) |path| sum += sizeBytes(try std.posix.fstatat(dir.fd, path, std.posix.AT.SYMLINK_NOFOLLOW));
+    return sum;
+}
+
+test "measure - per-child sums, total includes hidden entries and the directory" {
+    var tmp = std.testing.tmpDir(.{ .iterate = true });
+    defer tmp.cleanup();
+    try tmp.dir.makePath("a/deep/er");
+    try tmp.dir.makePath("b");
+    try tmp.dir.makePath(".hidden");
+    try testFile(tmp.dir, "a/one", 10000);
+    try testFile(tmp.dir, "a/deep/er/two", 20000);
+    try testFile(tmp.dir, "b/three", 5000);
+    try testFile(tmp.dir, ".hidden/four", 7000);
+    try testFile(tmp.dir, "top", 3000);
+
+    const a = try testBlocks(tmp.dir, "a") + try testBlocks(tmp.dir, "a/one") + try testBlocks(tmp.dir, "a/deep") +
+        try testBlocks(tmp.dir, "a/deep/er") + try testBlocks(tmp.dir, "a/deep/er/two");
+    const b = try testBlocks(tmp.dir, "b") + try testBlocks(tmp.dir, "b/three");
+    const hidden = try testBlocks(tmp.dir, ".hidden") + try testBlocks(tmp.dir, ".hidden/four");
+    const total = a + b + hidden + try testBlocks(tmp.dir, "top") + blockBytes(try std.posix.fstat(tmp.dir.fd));
+
+    const a_apparent = try testApparent(tmp.dir, &.{ "a", "a/one", "a/deep", "a/deep/er", "a/deep/er/two" });
+
+    for ([_]usize{ 1, 4 }) |workers| {
+        const names = [_][]const u8{ "b", "top", "a" };
+        var usage: [3]Usage = undefined;
+        const sum = try measure(tmp.dir, &names, &usage, workers, null);
+        try std.testing.expectEqual(total, sum.disk);
+        try std.testing.expectEqual(@as(u64, 5), sum.files);
+        try std.testing.expectEqual(@as(u64, 5), sum.dirs); // a, a/deep, a/deep/er, b, .hidden
+        try std.testing.expectEqual(b, usage[0].disk);
+        try std.testing.expectEqual(Usage{}, usage[1]); // Not a directory
+        try std.testing.expectEqual(Usage{ .disk = a, .apparent = a_apparent, .files = 2, .dirs = 2 }, usage[2]);
+    }
+}
+
+test "measure - symlinks not followed, hard links counted once" {
+    var tmp = std.testing.tmpDir(.{ .iterate = true });
+    defer tmp.cleanup();
+    try tmp.dir.makePath("a");
+    try tmp.dir.makePath("b");
+    try tmp.dir.makePath("big");
+    try testFile(tmp.dir, "big/data", 64 * 1024);
+    try testFile(tmp.dir, "a/shared", 32 * 1024);
+    try std.posix.linkat(tmp.dir.fd, "a/shared", tmp.dir.fd, "b/shared", 0);
+    try tmp.dir.symLink("../big", "a/link", .{ .is_directory = true });
+
+    const names = [_][]const u8{ "a", "b" };
+    var usage: [2]Usage = undefined;
+    const total = (try measure(tmp.dir, &names, &usage, 2, null)).disk;
+    const sizes = [_]u64{ usage[0].disk, usage[1].disk };
+
+    const shared = try testBlocks(tmp.dir, "a/shared");
+    const a_dir = try testBlocks(tmp.dir, "a") + try testBlocks(tmp.dir, "a/link");
+    const b_dir = try testBlocks(tmp.dir, "b");
+    // The link's blocks land in exactly one of a and b
+    try std.testing.expectEqual(a_dir + b_dir + shared, sizes[0] + sizes[1]);
+    try std.testing.expect(sizes[0] < a_dir + try testBlocks(tmp.dir, "big/data"));
+    try std.testing.expect(total >= sizes[0] + sizes[1] + try testBlocks(tmp.dir, "big/data"));
+}
+
+test "measure - wide directory: every name finds its own slot" {
+    var tmp = std.testing.tmpDir(.{ .iterate = true });
+    defer tmp.cleanup();
+    const count = 3000;
+    var names: [count][]const u8 = undefined;
+    var name_bufs: [count][16]u8 = undefined;
+    var expected: [count]u64 = undefined;
+    for (&names, &name_bufs, &expected, 0..) |*name, *buf, *size, i| {
+        // Listed in reverse creation order, so slots can't line up by accident
+        name.* = try std.fmt.bufPrint(buf, "d{d}", .{count - 1 - i});
+        try tmp.dir.makeDir(name.*);
+        var sub = try tmp.dir.openDir(name.*, .{});
+        defer sub.close();
+        if (i % 7 == 0) try testFile(sub, "f", 4096 * (i % 5 + 1));
+        size.* = try testBlocks(tmp.dir, name.*) + (testBlocks(sub, "f") catch 0);
+    }
+
+    var usage: [count]Usage = undefined;
+    _ = try measure(tmp.dir, &names, &usage, 4, null);
+    for (expected, usage) |size, got| try std.testing.expectEqual(size, got.disk);
+}
+
+test "measure - size cache skips per-file stats in unchanged directories" {
+    const gpa = std.testing.allocator;
+    var tmp = std.testing.tmpDir(.{ .iterate = true });
+    defer tmp.cleanup();
+    try tmp.dir.makePath("tree/a/sub");
+    try tmp.dir.makePath("tree/b");
+    try tmp.dir.makePath("cache");
+    try testFile(tmp.dir, "tree/a/one", 8192);
+    try testFile(tmp.dir, "tree/a/sub/two", 8192);
+    try testFile(tmp.dir, "tree/b/three", 8192);
+    const cache_dir = try tmp.dir.realpathAlloc(gpa, "cache");
+    defer gpa.free(cache_dir);
+    var tree = try tmp.dir.openDir("tree", .{ .iterate = true });
+    defer tree.close();
+
+    const names = [_][]const u8{ "a", "b" };
+    var cold: [2]Usage = undefined;
+    var warm: [2]Usage = undefined;
+    const later = std.time.nanoTimestamp() + 10 * std.time.ns_per_s; // Nothing is racy
+
+    var first = sizecache.SizeCache{ .dir_path = cache_dir, .now_ns = later };
+    const total = try measure(tree, &names, &cold, 2, &first);
+
+    // Grow a file in place: the cached directory doesn't notice...
+    try testFile(tree, "a/sub/two", 64 * 1024);
+    // ...but a new entry changes b's timestamps and b is counted again
+    try testFile(tree, "b/four", 8192);
+
+    var second = sizecache.SizeCache.open(cache_dir);
+    defer second.close();
+    second.now_ns = later;
+    try std.testing.expect(second.records.len >= 4);
+    const warm_total = try measure(tree, &names, &warm, 2, &second);
+    try std.testing.expectEqual(cold[0], warm[0]); // Apparent size and counts included
+    try std.testing.expectEqual(cold[1].disk + try testBlocks(tree, "b/four"), warm[1].disk);
+    try std.testing.expectEqual(cold[1].files + 1, warm[1].files);
+    try std.testing.expectEqual(total.disk + try testBlocks(tree, "b/four"), warm_total.disk);
+}
+
+test "deal - the biggest subtree is popped first" {
+    var tmp = std.testing.tmpDir(.{ .iterate = true });
+    defer tmp.cleanup();
+    try tmp.dir.makePath("small");
+    try tmp.dir.makePath("empty");
+    for (0..200) |i| {
+        var buf: [32]u8 = undefined;
+        try tmp.dir.makePath(try std.fmt.bufPrint(&buf, "big/d{d}", .{i}));
+    }
+
+    const names = [_][]const u8{ "small", "big", "empty" };
+    var walk = try Walk.init(&names, 1);
+    defer walk.deinit();
+    walk.scan(&walk.workers[0], try std.posix.openat(tmp.dir.fd, ".", .{ .DIRECTORY = true, .CLOEXEC = true }, 0), no_root);
+
+    const queued = walk.workers[0].deque.tasks.items;
+    try std.testing.expectEqual(@as(usize, 3), queued.len);
+    try std.testing.expectEqualStrings("big", queued[queued.len - 1].name);
+    walk.work(0);
+    try std.testing.expect(walk.ended.isSet());
+}
+
+test "Walk - stop skips unopened directories and marks their roots partial" {
+    var tmp = std.testing.tmpDir(.{ .iterate = true });
+    defer tmp.cleanup();
+    try tmp.dir.makePath("a/deeper");
+    try testFile(tmp.dir, "a/one", 8192);
+    try testFile(tmp.dir, "top", 4096);
+
+    const names = [_][]const u8{ "a", "top" };
+    var walk = try Walk.init(&names, 1);
+    defer walk.deinit();
+    walk.scan(&walk.workers[0], try std.posix.openat(tmp.dir.fd, ".", .{ .DIRECTORY = true, .CLOEXEC = true }, 0), no_root);
+    try std.testing.expectEqual(@as(u32, 1), walk.outstanding[0].load(.monotonic));
+    walk.stopped.store(true, .monotonic);
+    walk.work(0);
+
+    try std.testing.expect(walk.ended.isSet());
+    try std.testing.expectEqual(@as(u32, 0), walk.outstanding[0].load(.monotonic));
+    try std.testing.expect(walk.cut[0].load(.monotonic));
+    try std.testing.expect(!walk.cut[1].load(.monotonic)); // Not a directory: nothing to skip
+    try std.testing.expectEqual(Usage{}, walk.usage[0].load());
+    try std.testing.expect(walk.cut_any.load(.monotonic));
+    try std.testing.expectEqual(try testBlocks(tmp.dir, "top") + blockBytes(try std.posix.fstat(tmp.dir.fd)), walk.total.load().disk);
+}
+
+test "measure - empty names still sums the directory" {
+    var tmp = std.testing.tmpDir(.{ .iterate = true });
+    defer tmp.cleanup();
+    try testFile(tmp.dir, "f", 1000);
+    const total = try measure(tmp.dir, &.{}, &.{}, 3, null);
+    try std.testing.expectEqual(try testBlocks(tmp.dir, "f") + blockBytes(try std.posix.fstat(tmp.dir.fd)), total.disk);
+    try std.testing.expectEqual(Usage{ .disk = total.disk, .apparent = total.apparent, .files = 1, .dirs = 0 }, total);
+}
@@ -1,56 +1,81 @@
 const std = @import("std");
+const builtin = @import("builtin");
 const types = @import("types.zig");
-const git = @import("git.zig");
+const metadata = @import("metadata.zig");
+const pattern = @import("pattern.zig");
+const dirsize = @import("dirsize.zig");
+const sizecache = @import("sizecache.zig");
 const c = @cImport({
     @cInclude("utf8proc.h");
 });
 
-/// Compare two UTF-8 strings, handling macOS NFD/NFC normalization differences.
-/// Returns true if strings are equivalent using Unicode NFC normalization.
+/// Positional file filters (`lg a b c`, shell-expanded globs), normalized once.
 ///
-/// This function uses utf8proc to normalize both strings to NFC (Canonical Composition)
-/// before comparison, which handles the case where macOS filesystem uses NFD (decomposed)
-/// while shell arguments use NFC (composed) form for Unicode characters.
-fn utf8Equal(a: []const u8, b: []const u8) bool {
-    // Fast path: exact byte match (handles ASCII and already-normalized strings)
-    if (std.mem.eql(u8, a, b)) return true;
-
-    // Normalize both strings to NFC for comparison
-    // utf8proc_NFC returns a malloc'd string that must be freed
-    const a_nfc = c.utf8proc_NFC(a.ptr);
-    if (a_nfc == null) return false;
-    defer c.free(a_nfc);
-
-    const b_nfc = c.utf8proc_NFC(b.ptr);
-    if (b_nfc == null) {
-        return false;
+/// Each filter is stored as given and in Unicode NFC, so most entries match or
+/// miss with a single hash lookup. Only non-ASCII names that miss pay for one
+/// NFC pass - this covers macOS filesystems storing NFD while shells pass NFC.
+const FilterSet = struct {
+    set: std.StringHashMapUnmanaged(void) = .empty,
+    arena: std.heap.ArenaAllocator,
+
+    fn init(allocator: std.mem.Allocator, filters: []const []const u8) !FilterSet {
+        var self = FilterSet{ .arena = .init(allocator) };
+        errdefer self.deinit(allocator);
+
+        try self.set.ensureTotalCapacity(allocator, @intCast(filters.len * 2));
+        for (filters) |filter| {
+            self.set.putAssumeCapacity(filter, {});
+            if (isAscii(filter)) continue; // NFC leaves ASCII unchanged
+
+            const nfc = normalizeNfc(filter) orelse continue; // Invalid UTF-8: exact match only
+            defer c.free(nfc.ptr);
+            self.set.putAssumeCapacity(try self.arena.allocator().dupe(u8, nfc), {});
+        }
+        return self;
     }
-    defer c.free(b_nfc);
 
-    // Compare normalized strings
-    // Both are null-terminated C strings
-    const a_len = std.mem.len(a_nfc);
-    const b_len = std.mem.len(b_nfc);
+    fn deinit(self: *FilterSet, allocator: std.mem.Allocator) void {
+        self.set.deinit(allocator);
+        self.arena.deinit();
+    }
 
-    if (a_len != b_len) return false;
+    fn contains(self: *const FilterSet, name: []const u8) bool {
+        // Fast path: exact byte match (ASCII and already-normalized names)
+        if (self.set.contains(name)) return true;
+        if (isAscii(name)) return false;
 
-    return std.mem.eql(u8, a_nfc[0..a_len], b_nfc[0..b_len]);
+        const nfc = normalizeNfc(name) orelse return false;
+        defer c.free(nfc.ptr);
+        return self.set.contains(nfc);
+    }
+};
+
+fn isAscii(s: []const u8) bool {
+    for (s) |byte| {
+        if (byte >= 0x80) return false;
+    }
+    return true;
+}
+
+/// NFC-normalize `s` (length-delimited, no NUL needed).
+/// Returns a malloc'd slice the caller frees with c.free, or null for invalid UTF-8.
+fn normalizeNfc(s: []const u8) ?[]u8 {
+    var out: [*c]u8 = null;
+    const len = c.utf8proc_map(s.ptr, @intCast(s.len), &out, @intCast(c.UTF8PROC_STABLE | c.UTF8PROC_COMPOSE));
+    if (len < 0 or out == null) return null;
+    return out[0..@intCast(len)];
 }
 
 /// List files in directory based on config.
-/// Returns owned slice of FileInfo - caller must free each FileInfo.name and the slice itself.
-pub fn listFiles(
-    allocator: std.mem.Allocator,
-    config: types.Config,
-    git_ctx: ?*const git.GitContext,
-) ![]types.FileInfo {
+/// Names are packed into one arena (Listing.names); free both with Listing.deinit.
+/// Git status is left .clean; GitContext.annotate joins it on afterwards so
+/// `git status` can run while the directory is read. With -d the "." entry
+/// is added, but directory sums are left to calculateDirSizes or DirSizes.
+pub fn listFiles(allocator: std.mem.Allocator, config: types.Config) !types.Listing {
+    var names: types.NameArena = .{};
+    defer names.deinit(allocator);
     var list: std.ArrayList(types.FileInfo) = .empty;
-    errdefer {
-        for (list.items) |*item| {
-            allocator.free(item.name);
-        }
-        list.deinit(allocator);
-    }
+    errdefer list.deinit(allocator);
 
     // Add current directory entry when -d is used (like C version)
     if (config.calc_dir_sizes) {
@@ -58,27 +83,17 @@ pub fn listFiles(
             std.debug.print("Error: couldn't stat directory '{s}': {}\n", .{ config.dir_path, err });
             return err;
         };
-
-        const mtime_ts = dir_stat.mtime();
-        const mtime_ns = @as(i128, mtime_ts.sec) * std.time.ns_per_s + mtime_ts.nsec;
-
-        // Calculate current directory size
-        var dir_size: u64 = 0;
-        if (config.calc_dir_sizes) {
-            // We'll calculate this size later in batch
-            dir_size = 0;
-        }
+        const st = metadata.Stat.fromPosix(dir_stat);
 
         try list.append(allocator, .{
-            .name = try allocator.dupe(u8, "."),
-            .mode = dir_stat.mode,
-            .size = dir_size,
-            .mtime = mtime_ns,
-            .uid = dir_stat.uid,
-            .gid = dir_stat.gid,
+            .name = try names.append(allocator, "."),
+            .mode = types.FileInfo.packMode(st.mode, .directory),
+            .size = 0, // Filled in by calculateDirSizes
+            .mtime = st.mtime,
+            .uid = st.uid,
+            .gid = st.gid,
             .git_status = .clean, // Current dir doesn't have git status
-            .kind = .directory,
-            .inode = dir_stat.ino,
+            .inode = st.inode,
         });
     }
 
@@ -86,211 +101,678 @@ pub fn listFiles(
     var dir = try std.fs.cwd().openDir(config.dir_path, .{ .iterate = true });
     defer dir.close();
 
-    // Iterate entries
-    var iter = dir.iterate();
-    while (try iter.next()) |entry| {
-        // Skip . and ..
-        if (std.mem.eql(u8, entry.name, ".") or std.mem.eql(u8, entry.name, "..")) continue;
-
-        // Skip hidden files unless -a
-        if (!config.show_all and entry.name.len > 0 and entry.name[0] == '.') continue;
-
-        // Apply file filters if provided
-        if (config.file_filters) |filters| {
-            var match = false;
-            for (filters) |filter| {
-                if (utf8Equal(entry.name, filter)) {
-                    match = true;
-                    break;
-                }
-            }
-            if (!match) continue;
+    // Phase 1: enumerate using getdents data only (name, d_type)
+    const entries = try collectEntries(allocator, dir, config, &names);
+    defer allocator.free(entries);
+
+    // Phase 2: stat only the entries that need it (see metadata.Fields)
+    const fields = metadata.Fields.fromConfig(config);
+    const stats = try allocator.alloc(?metadata.Stat, entries.len);
+    defer allocator.free(stats);
+    collectMetadata(allocator, dir.fd, entries, names.bytes.items, fields, stats, config);
+
+    // Phase 3: build FileInfo
+    try appendFileInfos(allocator, &list, entries, stats, config.size_mode);
+
+    const name_bytes = try names.bytes.toOwnedSlice(allocator);
+    errdefer allocator.free(name_bytes);
+    return .{ .files = try list.toOwnedSlice(allocator), .names = name_bytes };
+}
+
+/// Entries per chunk in streamFiles. Also the look-ahead window display uses
+/// for size bars, so it bounds both memory and time to first output.
+pub const STREAM_CHUNK: usize = 4096;
+
+/// True when the listing can be emitted in directory order as it is read:
+/// unsorted (-U) and without -d, which needs every directory before du runs.
+pub fn canStream(config: types.Config) bool {
+    return config.unsorted and !config.calc_dir_sizes;
+}
+
+/// Streaming counterpart of listFiles for -U: enumerate, stat and emit
+/// STREAM_CHUNK entries at a time, calling `sink.emit(chunk: types.Listing)`
+/// for each. A chunk (files and names) is only valid during the call, so
+/// memory stays bounded however large the directory is.
+pub fn streamFiles(
+    allocator: std.mem.Allocator,
+    config: types.Config,
+    sink: anytype,
+) !void {
+    var dir = try std.fs.cwd().openDir(config.dir_path, .{ .iterate = true });
+    defer dir.close();
+
+    var filter = try EntryFilter.init(allocator, config);
+    defer filter.deinit(allocator);
+
+    var names: types.NameArena = .{};
+    defer names.deinit(allocator);
+    var entries: std.ArrayList(DirEntry) = .empty;
+    defer entries.deinit(allocator);
+    var files: std.ArrayList(types.FileInfo) = .empty;
+    defer files.deinit(allocator);
+    const stats = try allocator.alloc(?metadata.Stat, STREAM_CHUNK);
+    defer allocator.free(stats);
+
+    const fields = metadata.Fields.fromConfig(config);
+    var iter = DirIterator.init(dir);
+    var done = false;
+    while (!done) {
+        names.bytes.clearRetainingCapacity();
+        entries.clearRetainingCapacity();
+        files.clearRetainingCapacity();
+
+        while (entries.items.len < STREAM_CHUNK) {
+            const entry = (try iter.next()) orelse {
+                done = true;
+                break;
+            };
+            if (!filter.accepts(entry)) continue;
+            const name = try names.append(allocator, entry.name);
+            try entries.append(allocator, .{ .name = name, .kind = entry.kind });
+        }
+
+        const chunk_stats = stats[0..entries.items.len];
+        collectMetadata(allocator, dir.fd, entries.items, names.bytes.items, fields, chunk_stats, config);
+        try appendFileInfos(allocator, &files, entries.items, chunk_stats, config.size_mode);
+
+        if (files.items.len > 0) {
+            try sink.emit(types.Listing{ .files = files.items, .names = names.bytes.items });
         }
+    }
+}
 
-        // Get file metadata using posix.fstatat to get uid/gid
-        // Use SYMLINK_NOFOLLOW to prevent symlink loop attacks
-        const posix_stat = std.posix.fstatat(dir.fd, entry.name, std.posix.AT.SYMLINK_NOFOLLOW) catch |err| {
-            // Skip files we can't stat
-            std.debug.print("Warning: couldn't stat {s}: {}\n", .{ entry.name, err });
-            continue;
+/// Build FileInfo for each entry that was stat-ed successfully. The kind goes
+/// into the mode type bits, so entries that skipped stat still get
+/// S_IFDIR/S_IFLNK/S_IFREG from d_type.
+fn appendFileInfos(
+    allocator: std.mem.Allocator,
+    list: *std.ArrayList(types.FileInfo),
+    entries: []const DirEntry,
+    stats: []const ?metadata.Stat,
+    size_mode: ?types.SizeMode,
+) !void {
+    try list.ensureUnusedCapacity(allocator, entries.len);
+    for (entries, stats) |entry, maybe_st| {
+        const st = maybe_st orelse continue;
+
+        // Determine file kind (d_type, or the stat result when the filesystem doesn't report it)
+        const entry_kind = if (entry.kind == .unknown) kindFromMode(st.mode) else entry.kind;
+        const S = std.posix.S;
+        const type_bits: std.posix.mode_t = switch (entry_kind) {
+            .directory => S.IFDIR,
+            .sym_link => S.IFLNK,
+            .file => S.IFREG,
+            else => continue, // Special file behind DT_UNKNOWN (device, named_pipe, etc.)
         };
 
-        // Determine git status
-        const git_status: types.FileInfo.GitStatus = if (git_ctx) |ctx|
-            ctx.getStatus(entry.name, entry.kind == .directory)
+        list.appendAssumeCapacity(.{
+            .name = entry.name,
+            .mode = (st.mode & ~@as(std.posix.mode_t, S.IFMT)) | type_bits,
+            .size = if (size_mode == .disk) st.diskBytes() else st.size,
+            .mtime = st.mtime,
+            .uid = st.uid,
+            .gid = st.gid,
+            .git_status = .clean, // Joined in later by GitContext.annotate
+            // Not d_ino: on mount points and overlayfs it names the inode underneath
+            .inode = st.inode,
+        });
+    }
+}
+
+/// Directory entry from getdents, before any stat. `name` points into the listing's NameArena.
+const DirEntry = struct {
+    name: types.NameRef,
+    kind: std.fs.Dir.Entry.Kind,
+};
+
+/// Every filter that needs no metadata: dot entries, hidden files, file
+/// filters, glob patterns and special files with a known d_type.
+/// Rejected entries are never stat-ed.
+const EntryFilter = struct {
+    filter_set: ?FilterSet,
+    matcher: ?pattern.Matcher,
+    show_all: bool, // -a
+
+    fn init(allocator: std.mem.Allocator, config: types.Config) !EntryFilter {
+        var filter_set: ?FilterSet = if (config.file_filters) |filters| try FilterSet.init(allocator, filters) else null;
+        errdefer if (filter_set) |*set| set.deinit(allocator);
+        const matcher: ?pattern.Matcher = if (config.patterns) |patterns|
+            try pattern.Matcher.init(allocator, patterns, config.ignore_case)
         else
-            .clean;
-
-        // Determine file kind
-        const kind: types.FileInfo.FileKind = switch (entry.kind) {
-            .directory => .directory,
-            .sym_link => .symlink,
-            .file => .{ .file = .{ .executable = (posix_stat.mode & 0o111) != 0 } },
-            else => continue, // Skip special files (device, named_pipe, etc.)
-        };
+            null;
 
-        const mtime_ts = posix_stat.mtime();
-        const mtime_ns = @as(i128, mtime_ts.sec) * std.time.ns_per_s + mtime_ts.nsec;
+        return .{
+            .filter_set = filter_set,
+            .matcher = matcher,
+            .show_all = config.show_all,
+        };
+    }
 
-        try list.append(allocator, .{
-            .name = try allocator.dupe(u8, entry.name),
-            .mode = posix_stat.mode,
-            // Protect against integer overflow: saturate at max u64 instead of wrapping
-            .size = if (posix_stat.size < 0) 0 else @min(@as(u64, @intCast(posix_stat.size)), std.math.maxInt(u64)),
-            .mtime = mtime_ns,
-            .uid = posix_stat.uid,
-            .gid = posix_stat.gid,
-            .git_status = git_status,
-            .kind = kind,
-            .inode = posix_stat.ino,
-        });
+    fn deinit(self: *EntryFilter, allocator: std.mem.Allocator) void {
+        if (self.filter_set) |*set| set.deinit(allocator);
+        if (self.matcher) |m| m.deinit(allocator);
     }
 
-    // Calculate directory sizes if requested
-    if (config.calc_dir_sizes) {
-        try calculateDirSizes(allocator, config.dir_path, list.items);
+    fn accepts(self: *const EntryFilter, entry: RawEntry) bool {
+        // Skip . and ..
+        if (std.mem.eql(u8, entry.name, ".") or std.mem.eql(u8, entry.name, "..")) return false;
+
+        // Skip hidden files unless -a, or some pattern like '.*' asks for them
+        // (as in the shell: Matcher applies that rule per pattern)
+        const hidden = !self.show_all and entry.name.len > 0 and entry.name[0] == '.';
+        if (hidden and !(self.matcher != null and self.matcher.?.wants_hidden)) return false;
+
+        // Skip special files (device, named_pipe, etc.) before paying for a stat
+        switch (entry.kind) {
+            .file, .directory, .sym_link, .unknown => {},
+            else => return false,
+        }
+
+        // Apply file filters and patterns if provided: keep names matching either
+        if (self.filter_set == null and self.matcher == null) return true;
+        return (if (self.filter_set) |*set| !hidden and set.contains(entry.name) else false) or
+            (if (self.matcher) |*m| m.matches(entry.name, self.show_all) else false);
     }
+};
 
-    return list.toOwnedSlice(allocator);
-}
+/// Enumerate every entry accepted by EntryFilter.
+/// Names are appended to `names`; returns an owned slice of entries.
+fn collectEntries(
+    allocator: std.mem.Allocator,
+    dir: std.fs.Dir,
+    config: types.Config,
+    names: *types.NameArena,
+) ![]DirEntry {
+    var entries: std.ArrayList(DirEntry) = .empty;
+    errdefer entries.deinit(allocator);
 
-/// Validate path for security - prevents command injection and flag confusion.
-/// Returns error.InvalidPath if path contains dangerous patterns.
-/// Note: We use std.process.Child with array args (not shell execution),
-/// so most shell metacharacters are safe. We only reject truly dangerous patterns.
-fn validatePath(path: []const u8) !void {
-    // Reject null bytes (path truncation attacks)
-    if (std.mem.indexOfScalar(u8, path, 0) != null) return error.InvalidPath;
+    var filter = try EntryFilter.init(allocator, config);
+    defer filter.deinit(allocator);
 
-    // Reject paths starting with - (could be interpreted as flags by du)
-    if (path.len > 0 and path[0] == '-') return error.InvalidPath;
+    var iter = DirIterator.init(dir);
+    while (try iter.next()) |entry| {
+        if (!filter.accepts(entry)) continue;
+        const name = try names.append(allocator, entry.name);
+        try entries.append(allocator, .{ .name = name, .kind = entry.kind });
+    }
 
-    return;
+    return entries.toOwnedSlice(allocator);
 }
 
-/// Calculate directory sizes using `du -sk` in batch.
-/// Much faster than calling du once per directory.
-fn calculateDirSizes(
+/// Fill `stats[i]` for each entry. Entries that need nothing (lazy mode: known
+/// d_type and no displayed column needs stat data) get an empty Stat without a syscall.
+/// Entries that fail to stat get null and a warning.
+///
+/// Backends (config.stat_backend, `auto` picks by entry count):
+/// - serial: one statx/fstatat per entry on this thread
+/// - threads: workers claim fixed-size index chunks and write only their own
+///   slots, so output order is identical to the serial path
+/// - io_uring: IORING_OP_STATX submitted and reaped in batches; falls back to
+///   threads/serial when the ring can't be set up
+fn collectMetadata(
     allocator: std.mem.Allocator,
-    base_path: []const u8,
-    files: []types.FileInfo,
-) !void {
-    // Collect all directory paths
-    var dir_paths: std.ArrayList([]const u8) = .empty;
-    defer {
-        for (dir_paths.items) |path| allocator.free(path);
-        dir_paths.deinit(allocator);
+    dir_fd: std.posix.fd_t,
+    entries: []const DirEntry,
+    names: []const u8,
+    fields: metadata.Fields,
+    stats: []?metadata.Stat,
+    config: types.Config,
+) void {
+    var job = StatJob{
+        .dir_fd = dir_fd,
+        .entries = entries,
+        .names = names,
+        .fields = fields,
+        .flags = metadata.StatFlags.forDir(dir_fd),
+        .stats = stats,
+    };
+
+    // Lazy mode only stats DT_UNKNOWN entries - not worth a thread or a ring
+    if (fields.isEmpty()) {
+        job.run(0, entries.len);
+        return;
     }
 
-    for (files) |file| {
-        if (file.kind == .directory) {
-            // Handle "." specially - use base_path directly
-            const full_path = if (std.mem.eql(u8, file.name, "."))
-                try allocator.dupe(u8, base_path)
-            else
-                try std.fs.path.join(allocator, &.{ base_path, file.name });
+    const backend = config.stat_backend;
+    const want_uring = backend == .io_uring or
+        (backend == .auto and config.jobs == 0 and entries.len >= IO_URING_THRESHOLD);
+    if (want_uring) {
+        if (statWithIoUring(allocator, &job)) |_| {
+            return;
+        } else |err| {
+            // Forced backend: say why we fell back; auto stays quiet
+            if (backend == .io_uring) {
+                std.debug.print("Warning: io_uring unavailable ({}), using fstatat\n", .{err});
+            }
+        }
+    }
 
-            // Validate path before passing to subprocess to prevent command injection
-            try validatePath(full_path);
+    const workers = statWorkerCount(config.jobs, entries.len, job.flags, backend);
+    if (workers <= 1) {
+        job.run(0, entries.len);
+        return;
+    }
 
-            try dir_paths.append(allocator, full_path);
-        }
+    var threads: [MAX_STAT_JOBS]std.Thread = undefined;
+    var spawned: usize = 0;
+    while (spawned < workers - 1) : (spawned += 1) {
+        // If a spawn fails the remaining workers (and this thread) pick up the slack
+        threads[spawned] = std.Thread.spawn(.{ .stack_size = STAT_WORKER_STACK_SIZE }, StatJob.work, .{&job}) catch break;
     }
 
-    if (dir_paths.items.len == 0) return;
+    job.work();
+    for (threads[0..spawned]) |thread| thread.join();
+}
 
-    // Build args: ["du", "-sk", path1, path2, ...]
-    var args: std.ArrayList([]const u8) = .empty;
-    defer args.deinit(allocator);
+// Parallel stat tuning. The threshold and auto job counts are untested
+// starting guesses; bench/stat_backends.sh is the way to tune them.
+const PARALLEL_STAT_THRESHOLD: usize = 4096;  // Guess: where thread startup stops dominating
+const STAT_CHUNK_SIZE: usize = 256;           // Entries claimed per atomic fetch
+const MAX_STAT_JOBS: usize = 64;              // Upper bound for --jobs
+const AUTO_JOBS_LOCAL: usize = 8;             // Guess: cached local stats are CPU-bound
+const AUTO_JOBS_NETWORK: usize = 32;          // Guess: network stats are latency-bound
+const STAT_WORKER_STACK_SIZE: usize = 256 * 1024;
+
+// io_uring tuning
+const IO_URING_THRESHOLD: usize = 16 * 1024;  // Untested guess; compare with bench/stat_backends.sh
+const IO_URING_BATCH: u16 = 512;              // SQEs per submit; one io_uring_enter per batch
+
+/// Number of threads (including the caller) to stat `count` entries with.
+/// An explicit --jobs always wins; auto mode only kicks in above the threshold.
+fn statWorkerCount(jobs: usize, count: usize, flags: metadata.StatFlags, backend: types.StatBackend) usize {
+    const wanted = if (backend == .serial)
+        1
+    else if (jobs > 0)
+        jobs
+    else if (backend == .auto and count < PARALLEL_STAT_THRESHOLD)
+        1
+    else if (flags.dont_sync)
+        AUTO_JOBS_NETWORK
+    else
+        @min(std.Thread.getCpuCount() catch 1, AUTO_JOBS_LOCAL);
+
+    // Never more workers than chunks
+    const chunks = std.math.divCeil(usize, count, STAT_CHUNK_SIZE) catch 1;
+    return std.math.clamp(@min(wanted, chunks), 1, MAX_STAT_JOBS);
+}
 
-    try args.append(allocator, "du");
-    try args.append(allocator, "-sk");
-    try args.appendSlice(allocator, dir_paths.items);
+/// Stat every entry of `job` through io_uring: queue up to IO_URING_BATCH
+/// IORING_OP_STATX requests against the directory fd, submit them with one
+/// io_uring_enter, then reap completions in bulk.
+/// Returns an error when io_uring is unavailable; the caller then redoes the
+/// whole job with another backend, overwriting any slots already filled.
+fn statWithIoUring(allocator: std.mem.Allocator, job: *StatJob) !void {
+    if (builtin.os.tag != .linux) return error.IoUringUnavailable;
+    const linux = std.os.linux;
+
+    var ring = linux.IoUring.init(IO_URING_BATCH, 0) catch return error.IoUringUnavailable;
+    defer ring.deinit();
+
+    // Per-batch statx results; must not move while requests are in flight.
+    // Names are already NUL-terminated in the listing arena.
+    const bufs = try allocator.alloc(linux.Statx, IO_URING_BATCH);
+    // Requests submitted but not reaped yet. The kernel writes into bufs
+    // as they complete, so bail-outs wait for them first.
+    var in_flight: u32 = 0;
+    defer if (in_flight == 0) allocator.free(bufs); // Leaked if the drain failed
+    var cqes: [IO_URING_BATCH]linux.io_uring_cqe = undefined;
+    errdefer drainIoUring(&ring, &cqes, &in_flight);
+
+    // Fields are non-empty here, so the mask already carries STATX_TYPE for DT_UNKNOWN entries
+    const mask = job.fields.statxMask(false);
+    const at_flags = job.flags.statxFlags();
+    var first_batch = true;
+
+    var start: usize = 0;
+    while (start < job.entries.len) {
+        const end = @min(start + IO_URING_BATCH, job.entries.len);
+        const batch = job.entries[start..end];
+
+        var queued: u32 = 0;
+        for (batch, 0..) |entry, i| {
+            _ = try ring.statx(start + i, job.dir_fd, entry.name.in(job.names), at_flags, mask, &bufs[i]);
+            queued += 1;
+        }
+        const submitted = try ring.submit();
+        in_flight = submitted;
+
+        // Reap everything before touching the buffers again
+        var unsupported = false;
+        while (in_flight > 0) {
+            const n = ring.copy_cqes(&cqes, 1) catch |err| switch (err) {
+                error.SignalInterrupt => continue,
+                else => return err,
+            };
+            in_flight -= n;
+            for (cqes[0..n]) |cqe| {
+                const index: usize = @intCast(cqe.user_data);
+                if (cqe.res >= 0) {
+                    job.stats[index] = metadata.Stat.fromStatx(&bufs[index - start]);
+                    continue;
+                }
 
-    // Execute du with 30-second timeout
-    var child = std.process.Child.init(args.items, allocator);
-    child.stdout_behavior = .Pipe;
-    child.stderr_behavior = .Ignore;
+                const e = cqe.err();
+                // Kernels before 5.6 reject the opcode itself
+                if (first_batch and (e == .INVAL or e == .OPNOTSUPP)) {
+                    unsupported = true;
+                    continue;
+                }
+                std.debug.print("Warning: couldn't stat {s}: {}\n", .{ job.entries[index].name.in(job.names), metadata.statxError(e) });
+                job.stats[index] = null;
+            }
+        }
+        // A short submit left entries unstatted: redo the job another way
+        if (unsupported or submitted < queued) return error.IoUringUnavailable;
 
-    try child.spawn();
+        first_batch = false;
+        start = end;
+    }
+}
 
-    // Read stdout (blocks until process completes)
-    // du is typically fast, and OS has its own timeout mechanisms
-    const stdout = child.stdout.?.readToEndAlloc(allocator, types.DU_MAX_OUTPUT) catch |err| {
-        // On read error, kill child process
-        _ = child.kill() catch {};
-        return err;
-    };
-    defer allocator.free(stdout);
+/// Wait out the `in_flight` requests still writing into their statx
+/// buffers. If the ring itself fails the count stays above zero and the
+/// caller must not free the buffers.
+fn drainIoUring(ring: *std.os.linux.IoUring, cqes: []std.os.linux.io_uring_cqe, in_flight: *u32) void {
+    while (in_flight.* > 0) {
+        const n = ring.copy_cqes(cqes, 1) catch |err| switch (err) {
+            error.SignalInterrupt => continue,
+            else => return,
+        };
+        in_flight.* -|= n;
+    }
+}
 
-    const result = try child.wait();
+/// Shared state for stat workers. Each chunk is claimed by exactly one worker.
+const StatJob = struct {
+    dir_fd: std.posix.fd_t,
+    entries: []const DirEntry,
+    names: []const u8, // NameArena bytes the entries point into
+    fields: metadata.Fields,
+    flags: metadata.StatFlags,
+    stats: []?metadata.Stat,
+    next_index: std.atomic.Value(usize) = .init(0),
+
+    fn work(self: *StatJob) void {
+        while (true) {
+            const start = self.next_index.fetchAdd(STAT_CHUNK_SIZE, .monotonic);
+            if (start >= self.entries.len) return;
+            self.run(start, @min(start + STAT_CHUNK_SIZE, self.entries.len));
+        }
+    }
 
-    // Check exit status
-    switch (result) {
-        .Exited => |code| {
-            if (code != 0) {
-                // du failed, but we can continue - just won't have dir sizes
-                return;
+    fn run(self: *StatJob, start: usize, end: usize) void {
+        for (self.entries[start..end], self.stats[start..end]) |entry, *out| {
+            const need_type = entry.kind == .unknown;
+            if (self.fields.isEmpty() and !need_type) {
+                out.* = .{};
+                continue;
             }
-        },
-        else => {
-            // Process was terminated/killed, skip dir size calculation
-            return;
-        },
+
+            // Never follows symlinks to prevent symlink loop attacks
+            const name = entry.name.in(self.names);
+            out.* = metadata.statAt(self.dir_fd, name, self.fields, need_type, self.flags) catch |err| blk: {
+                // Skip files we can't stat
+                std.debug.print("Warning: couldn't stat {s}: {}\n", .{ name, err });
+                break :blk null;
+            };
+        }
     }
+};
 
-    // Parse output: "SIZE\tPATH\n"
-    var lines = std.mem.splitScalar(u8, stdout, '\n');
-    while (lines.next()) |line| {
-        if (line.len == 0) continue;
-
-        // Split on tab or space
-        var parts = std.mem.splitAny(u8, line, " \t");
-        const size_str = parts.next() orelse continue;
-        const path = parts.rest();
-
-        const size_kb = std.fmt.parseInt(u64, size_str, 10) catch continue;
-
-        // Find matching file entry and update size
-        for (files) |*file| {
-            if (file.kind != .directory) continue;
-
-            // Handle "." specially
-            const full_path = if (std.mem.eql(u8, file.name, "."))
-                try allocator.dupe(u8, base_path)
-            else
-                try std.fs.path.join(allocator, &.{ base_path, file.name });
-            defer allocator.free(full_path);
-
-            if (std.mem.eql(u8, full_path, path)) {
-                // Protect against integer overflow: use saturating multiplication
-                const size_bytes = std.math.mul(u64, size_kb, 1024) catch std.math.maxInt(u64);
-                file.size = size_bytes;
-                break;
+/// Directory iterator yielding names and d_type.
+/// Linux reads getdents64 directly; elsewhere wraps std.fs.Dir.Iterator.
+pub const DirIterator = if (builtin.os.tag == .linux) LinuxDirIterator else PortableDirIterator;
+
+pub const RawEntry = struct {
+    name: []const u8, // Valid until the next call to next()
+    kind: std.fs.Dir.Entry.Kind,
+};
+
+const LinuxDirIterator = struct {
+    const linux = std.os.linux;
+
+    fd: std.posix.fd_t,
+    // 32KB like GNU ls: a few hundred entries per getdents64 call
+    buf: [32 * 1024]u8 align(@alignOf(linux.dirent64)) = undefined,
+    index: usize = 0,
+    end: usize = 0,
+
+    fn init(dir: std.fs.Dir) LinuxDirIterator {
+        return .{ .fd = dir.fd };
+    }
+
+    fn next(self: *LinuxDirIterator) !?RawEntry {
+        if (self.index >= self.end) {
+            const rc = linux.getdents64(self.fd, &self.buf, self.buf.len);
+            switch (std.posix.errno(rc)) {
+                .SUCCESS => {},
+                .NOENT => return null, // Directory removed while listing
+                .ACCES => return error.AccessDenied,
+                else => |e| return std.posix.unexpectedErrno(e),
             }
+            if (rc == 0) return null;
+            self.index = 0;
+            self.end = rc;
         }
+
+        const d: *align(1) linux.dirent64 = @ptrCast(&self.buf[self.index]);
+        self.index += d.reclen;
+
+        const name = std.mem.sliceTo(@as([*:0]u8, @ptrCast(&d.name)), 0);
+        const kind: std.fs.Dir.Entry.Kind = switch (d.type) {
+            linux.DT.BLK => .block_device,
+            linux.DT.CHR => .character_device,
+            linux.DT.DIR => .directory,
+            linux.DT.FIFO => .named_pipe,
+            linux.DT.LNK => .sym_link,
+            linux.DT.REG => .file,
+            linux.DT.SOCK => .unix_domain_socket,
+            else => .unknown,
+        };
+        return .{ .name = name, .kind = kind };
+    }
+};
+
+const PortableDirIterator = struct {
+    inner: std.fs.Dir.Iterator,
+
+    fn init(dir: std.fs.Dir) PortableDirIterator {
+        return .{ .inner = dir.iterate() };
+    }
+
+    fn next(self: *PortableDirIterator) !?RawEntry {
+        const entry = (try self.inner.next()) orelse return null;
+        return .{ .name = entry.name, .kind = entry.kind };
     }
+};
+
+/// Map stat mode type bits to a directory entry kind (for DT_UNKNOWN entries).
+fn kindFromMode(mode: std.posix.mode_t) std.fs.Dir.Entry.Kind {
+    const S = std.posix.S;
+    if (S.ISDIR(mode)) return .directory;
+    if (S.ISLNK(mode)) return .sym_link;
+    if (S.ISREG(mode)) return .file;
+    return .unknown;
 }
 
+/// Fill in -d sums for every directory in `listing` (and the total for
+/// "."), waiting for the walk. Past --size-budget the walk stops and
+/// unfinished sums are marked partial. File and directory counts go to
+/// `counts` when given.
+pub fn calculateDirSizes(allocator: std.mem.Allocator, listing: types.Listing, config: types.Config, counts: ?*types.TreeCounts) !void {
+    var sizes = try DirSizes.start(allocator, listing, config, counts);
+    defer sizes.deinit();
+    try sizes.finish(listing);
+}
+
+/// -d sums of a listing, walked on background threads (dirsize.Measure).
+/// Rows keep their listing index, so sort before starting. apply() copies
+/// the sums so far into the listing, with each row's SizeState: disk
+/// usage, or apparent bytes with --size-mode=apparent (one walk counts
+/// both).
+pub const DirSizes = struct {
+    allocator: std.mem.Allocator,
+    measure: ?*dirsize.Measure,
+    indexes: []const usize, // Listing index of each measured name
+    dot: ?usize, // Listing index of "."
+    deadline_ns: ?i128, // --size-budget
+    cache: ?*sizecache.SizeCache,
+    mode: types.SizeMode,
+    counts: ?*types.TreeCounts,
+
+    pub fn start(allocator: std.mem.Allocator, listing: types.Listing, config: types.Config, counts: ?*types.TreeCounts) !DirSizes {
+        var names: std.ArrayList([]const u8) = .empty;
+        defer names.deinit(allocator);
+        var indexes: std.ArrayList(usize) = .empty;
+        errdefer indexes.deinit(allocator);
+        var dot: ?usize = null;
+
+        for (listing.files, 0..) |file, i| {
+            if (!file.isDir()) continue;
+            const name = listing.name(file);
+            if (std.mem.eql(u8, name, ".")) {
+                dot = i;
+                continue;
+            }
+            try names.append(allocator, name);
+            try indexes.append(allocator, i);
+        }
+        const owned_indexes = try indexes.toOwnedSlice(allocator);
+        errdefer allocator.free(owned_indexes);
+        // apply() runs mid-walk and can't fail: room for every row up front
+        if (counts) |map| try map.ensureUnusedCapacity(allocator, @intCast(owned_indexes.len + 1));
+
+        var dir = try std.fs.cwd().openDir(config.dir_path, .{});
+        defer dir.close();
+        // A tree walk has no entry count up front: size the pool like a large stat job
+        const workers = statWorkerCount(config.jobs, std.math.maxInt(usize), metadata.StatFlags.forDir(dir.fd), config.stat_backend);
+
+        // The walk reads the cache until finish(), so it can't live on this frame
+        var cache: ?*sizecache.SizeCache = null;
+        errdefer if (cache) |sc| closeCache(allocator, sc);
+        var cache_buf: [std.fs.max_path_bytes]u8 = undefined;
+        const cache_dir = if (config.size_cache) sizecache.defaultDir(&cache_buf) else null;
+        if (cache_dir) |path| {
+            const owned_path = try allocator.dupe(u8, path);
+            errdefer allocator.free(owned_path);
+            cache = try allocator.create(sizecache.SizeCache);
+            cache.?.* = sizecache.SizeCache.open(owned_path);
+        }
+
+        var self = DirSizes{
+            .allocator = allocator,
+            .measure = try dirsize.Measure.start(dir, names.items, workers, cache),
+            .indexes = owned_indexes,
+            .dot = dot,
+            .deadline_ns = if (config.size_budget_ns) |budget| std.time.nanoTimestamp() + budget else null,
+            .cache = cache,
+            .mode = config.size_mode orelse .disk,
+            .counts = counts,
+        };
+        self.apply(listing);
+        return self;
+    }
+
+    /// Stop the walk if it is still running and release it. Names in the
+    /// listing (which the walk reads) must still be alive.
+    pub fn deinit(self: *DirSizes) void {
+        if (self.measure) |m| m.destroy();
+        self.measure = null;
+        if (self.cache) |sc| closeCache(self.allocator, sc);
+        self.cache = null;
+        self.allocator.free(self.indexes);
+        self.indexes = &.{};
+    }
+
+    fn closeCache(allocator: std.mem.Allocator, cache: *sizecache.SizeCache) void {
+        cache.close();
+        allocator.free(cache.dir_path);
+        allocator.destroy(cache);
+    }
+
+    /// Wait up to `timeout_ns` for another subtree to finish, stopping the
+    /// walk once the budget is spent. False when the walk is over.
+    pub fn wait(self: *DirSizes, timeout_ns: u64) bool {
+        const m = self.measure orelse return false;
+        if (!m.running()) return false;
+        m.waitChange(self.budgeted(m, timeout_ns));
+        return true;
+    }
+
+    pub fn running(self: *const DirSizes) bool {
+        const m = self.measure orelse return false;
+        return m.running();
+    }
+
+    /// Wait for the walk to end (or the budget), write the size cache and
+    /// leave the final sums in `listing`.
+    pub fn finish(self: *DirSizes, listing: types.Listing) !void {
+        const m = self.measure orelse return;
+        while (!m.waitEnd(self.budgeted(m, std.math.maxInt(u64)))) {}
+        try m.join();
+        self.apply(listing);
+    }
+
+    /// Copy the sums counted so far into `listing`.
+    pub fn apply(self: *const DirSizes, listing: types.Listing) void {
+        const m = self.measure orelse return;
+        for (self.indexes, 0..) |i, slot| {
+            // State first: a sum read after "exact" is the final one
+            const state = m.state(slot);
+            self.set(&listing.files[i], m.usage(slot), state);
+        }
+        if (self.dot) |i| {
+            const state = m.totalState();
+            self.set(&listing.files[i], m.total(), state);
+        }
+    }
+
+    fn set(self: *const DirSizes, file: *types.FileInfo, usage: dirsize.Usage, state: types.FileInfo.SizeState) void {
+        file.size = switch (self.mode) {
+            .disk => usage.disk,
+            .apparent => usage.apparent,
+        };
+        file.size_state = state;
+        if (self.counts) |map| map.putAssumeCapacity(file.name.off, .{ .files = usage.files, .dirs = usage.dirs });
+    }
+
+    /// `timeout_ns` capped at the budget; past it, stop the walk (the
+    /// skipped tasks then drain at once).
+    fn budgeted(self: *const DirSizes, m: *dirsize.Measure, timeout_ns: u64) u64 {
+        const deadline = self.deadline_ns orelse return timeout_ns;
+        const left = deadline - std.time.nanoTimestamp();
+        if (left <= 0) {
+            m.stop();
+            return timeout_ns;
+        }
+        return @min(timeout_ns, @as(u64, @intCast(left)));
+    }
+};
+
 /// Sort files based on config options.
-pub fn sortFiles(files: []types.FileInfo, config: types.Config) void {
+/// Names are compared in place in the listing arena.
+pub fn sortFiles(listing: types.Listing, config: types.Config) void {
     // Skip sorting if -U (unsorted) flag is set
     if (config.unsorted) return;
 
     const Context = struct {
         cfg: types.Config,
+        names: []const u8,
 
         pub fn lessThan(ctx: @This(), a: types.FileInfo, b: types.FileInfo) bool {
+            const a_name = a.name.in(ctx.names);
+            const b_name = b.name.in(ctx.names);
+
             if (ctx.cfg.group_by_type) {
                 // Directories first
-                const a_is_dir = a.kind == .directory;
-                const b_is_dir = b.kind == .directory;
+                const a_is_dir = a.isDir();
+                const b_is_dir = b.isDir();
                 if (a_is_dir != b_is_dir) return a_is_dir;
 
                 // Group files by extension
                 if (!a_is_dir) {
-                    const ext_a = std.fs.path.extension(a.name);
-                    const ext_b = std.fs.path.extension(b.name);
+                    const ext_a = std.fs.path.extension(a_name);
+                    const ext_b = std.fs.path.extension(b_name);
                     const ext_cmp = std.mem.order(u8, ext_a, ext_b);
                     if (ext_cmp != .eq) return ext_cmp == .lt;
                 }
@@ -298,8 +780,8 @@ pub fn sortFiles(files: []types.FileInfo, config: types.Config) void {
 
             // Sort by extension if -X is specified
             if (ctx.cfg.sort_by_extension) {
-                const ext_a = std.fs.path.extension(a.name);
-                const ext_b = std.fs.path.extension(b.name);
+                const ext_a = std.fs.path.extension(a_name);
+                const ext_b = std.fs.path.extension(b_name);
 
                 // Files without extension come first
                 const has_ext_a = ext_a.len > 0;
@@ -313,7 +795,7 @@ pub fn sortFiles(files: []types.FileInfo, config: types.Config) void {
                 }
 
                 // Same extension (or both no extension) - sort alphabetically by name (ls -X behavior)
-                return std.ascii.lessThanIgnoreCase(a.name, b.name);
+                return std.ascii.lessThanIgnoreCase(a_name, b_name);
             }
 
             // Primary sort criteria
@@ -327,28 +809,25 @@ pub fn sortFiles(files: []types.FileInfo, config: types.Config) void {
 
             // Secondary sort: alphabetical (fallback for ties or if -n specified)
             if (ctx.cfg.sort_alphabetical) {
-                return std.ascii.lessThanIgnoreCase(a.name, b.name);
+                return std.ascii.lessThanIgnoreCase(a_name, b_name);
             }
 
             // Final fallback: alphabetical
-            return std.ascii.lessThanIgnoreCase(a.name, b.name);
+            return std.ascii.lessThanIgnoreCase(a_name, b_name);
         }
     };
 
-    std.mem.sort(types.FileInfo, files, Context{ .cfg = config }, Context.lessThan);
+    std.mem.sort(types.FileInfo, listing.files, Context{ .cfg = config, .names = listing.names }, Context.lessThan);
 
     // Reverse order if requested
     if (config.reverse_order) {
-        std.mem.reverse(types.FileInfo, files);
+        std.mem.reverse(types.FileInfo, listing.files);
     }
 }
 
-/// Free a slice of FileInfo
-pub fn freeFileList(allocator: std.mem.Allocator, files: []types.FileInfo) void {
-    for (files) |*file| {
-        allocator.free(file.name);
-    }
-    allocator.free(files);
+/// Free a listing returned by listFiles
+pub fn freeFileList(allocator: std.mem.Allocator, listing: types.Listing) void {
+    listing.deinit(allocator);
 }
 
 // ═══════════════════════════════════════════════════════════
@@ -356,7 +835,7 @@ pub fn freeFileList(allocator: std.mem.Allocator, files: []types.FileInfo) void
 // ═══════════════════════════════════════════════════════════
 
 test "sortFiles - alphabetical ascending" {
-    var files = [_]types.FileInfo{
+    const listing = try types.Listing.fromSpecs(std.testing.allocator, &.{
         .{
             .name = "zebra.txt",
             .mode = 0o644,
@@ -379,19 +858,20 @@ test "sortFiles - alphabetical ascending" {
             .kind = .{ .file = .{ .executable = false } },
             .inode = 0,
         },
-    };
+    });
+    defer listing.deinit(std.testing.allocator);
 
     var config = types.Config.default();
     config.sort_alphabetical = true;
 
-    sortFiles(&files, config);
+    sortFiles(listing, config);
 
-    try std.testing.expectEqualStrings("apple.txt", files[0].name);
-    try std.testing.expectEqualStrings("zebra.txt", files[1].name);
+    try std.testing.expectEqualStrings("apple.txt", listing.name(listing.files[0]));
+    try std.testing.expectEqualStrings("zebra.txt", listing.name(listing.files[1]));
 }
 
 test "sortFiles - alphabetical case insensitive" {
-    var files = [_]types.FileInfo{
+    const listing = try types.Listing.fromSpecs(std.testing.allocator, &.{
         .{
             .name = "Zebra.txt",
             .mode = 0o644,
@@ -425,20 +905,21 @@ test "sortFiles - alphabetical case insensitive" {
             .kind = .{ .file = .{ .executable = false } },
             .inode = 0,
         },
-    };
+    });
+    defer listing.deinit(std.testing.allocator);
 
     var config = types.Config.default();
     config.sort_alphabetical = true;
 
-    sortFiles(&files, config);
+    sortFiles(listing, config);
 
-    try std.testing.expectEqualStrings("apple.txt", files[0].name);
-    try std.testing.expectEqualStrings("BANANA.txt", files[1].name);
-    try std.testing.expectEqualStrings("Zebra.txt", files[2].name);
+    try std.testing.expectEqualStrings("apple.txt", listing.name(listing.files[0]));
+    try std.testing.expectEqualStrings("BANANA.txt", listing.name(listing.files[1]));
+    try std.testing.expectEqualStrings("Zebra.txt", listing.name(listing.files[2]));
 }
 
 test "sortFiles - by time (mtime ascending)" {
-    var files = [_]types.FileInfo{
+    const listing = try types.Listing.fromSpecs(std.testing.allocator, &.{
         .{
             .name = "newer.txt",
             .mode = 0o644,
@@ -461,20 +942,21 @@ test "sortFiles - by time (mtime ascending)" {
             .kind = .{ .file = .{ .executable = false } },
             .inode = 0,
         },
-    };
+    });
+    defer listing.deinit(std.testing.allocator);
 
     var config = types.Config.default();
     config.sort_alphabetical = false; // Sort by time
 
-    sortFiles(&files, config);
+    sortFiles(listing, config);
 
     // Older files first (ascending mtime)
-    try std.testing.expectEqualStrings("older.txt", files[0].name);
-    try std.testing.expectEqualStrings("newer.txt", files[1].name);
+    try std.testing.expectEqualStrings("older.txt", listing.name(listing.files[0]));
+    try std.testing.expectEqualStrings("newer.txt", listing.name(listing.files[1]));
 }
 
 test "sortFiles - by time with multiple files" {
-    var files = [_]types.FileInfo{
+    const listing = try types.Listing.fromSpecs(std.testing.allocator, &.{
         .{
             .name = "newest.txt",
             .mode = 0o644,
@@ -508,20 +990,21 @@ test "sortFiles - by time with multiple files" {
             .kind = .{ .file = .{ .executable = false } },
             .inode = 0,
         },
-    };
+    });
+    defer listing.deinit(std.testing.allocator);
 
     var config = types.Config.default();
     config.sort_alphabetical = false;
 
-    sortFiles(&files, config);
+    sortFiles(listing, config);
 
-    try std.testing.expectEqualStrings("oldest.txt", files[0].name);
-    try std.testing.expectEqualStrings("middle.txt", files[1].name);
-    try std.testing.expectEqualStrings("newest.txt", files[2].name);
+    try std.testing.expectEqualStrings("oldest.txt", listing.name(listing.files[0]));
+    try std.testing.expectEqualStrings("middle.txt", listing.name(listing.files[1]));
+    try std.testing.expectEqualStrings("newest.txt", listing.name(listing.files[2]));
 }
 
 test "sortFiles - group by type, directories first" {
-    var files = [_]types.FileInfo{
+    const listing = try types.Listing.fromSpecs(std.testing.allocator, &.{
         .{
             .name = "file.txt",
             .mode = 0o644,
@@ -544,22 +1027,23 @@ test "sortFiles - group by type, directories first" {
             .kind = .directory,
             .inode = 0,
         },
-    };
+    });
+    defer listing.deinit(std.testing.allocator);
 
     var config = types.Config.default();
     config.group_by_type = true;
 
-    sortFiles(&files, config);
+    sortFiles(listing, config);
 
     // Directories first
-    try std.testing.expect(files[0].kind == .directory);
-    try std.testing.expectEqualStrings("dir", files[0].name);
-    try std.testing.expect(files[1].kind == .file);
-    try std.testing.expectEqualStrings("file.txt", files[1].name);
+    try std.testing.expect(listing.files[0].kind() == .directory);
+    try std.testing.expectEqualStrings("dir", listing.name(listing.files[0]));
+    try std.testing.expect(listing.files[1].kind() == .file);
+    try std.testing.expectEqualStrings("file.txt", listing.name(listing.files[1]));
 }
 
 test "sortFiles - group by type with multiple directories" {
-    var files = [_]types.FileInfo{
+    const listing = try types.Listing.fromSpecs(std.testing.allocator, &.{
         .{
             .name = "file1.txt",
             .mode = 0o644,
@@ -604,26 +1088,27 @@ test "sortFiles - group by type with multiple directories" {
             .kind = .directory,
             .inode = 0,
         },
-    };
+    });
+    defer listing.deinit(std.testing.allocator);
 
     var config = types.Config.default();
     config.group_by_type = true;
     config.sort_alphabetical = true;
 
-    sortFiles(&files, config);
+    sortFiles(listing, config);
 
     // First two should be directories, sorted alphabetically
-    try std.testing.expect(files[0].kind == .directory);
-    try std.testing.expectEqualStrings("dir_a", files[0].name);
-    try std.testing.expect(files[1].kind == .directory);
-    try std.testing.expectEqualStrings("dir_b", files[1].name);
+    try std.testing.expect(listing.files[0].kind() == .directory);
+    try std.testing.expectEqualStrings("dir_a", listing.name(listing.files[0]));
+    try std.testing.expect(listing.files[1].kind() == .directory);
+    try std.testing.expectEqualStrings("dir_b", listing.name(listing.files[1]));
     // Last two should be files
-    try std.testing.expect(files[2].kind == .file);
-    try std.testing.expect(files[3].kind == .file);
+    try std.testing.expect(listing.files[2].kind() == .file);
+    try std.testing.expect(listing.files[3].kind() == .file);
 }
 
 test "sortFiles - group by extension" {
-    var files = [_]types.FileInfo{
+    const listing = try types.Listing.fromSpecs(std.testing.allocator, &.{
         .{
             .name = "script.sh",
             .mode = 0o755,
@@ -657,33 +1142,35 @@ test "sortFiles - group by extension" {
             .kind = .{ .file = .{ .executable = false } },
             .inode = 0,
         },
-    };
+    });
+    defer listing.deinit(std.testing.allocator);
 
     var config = types.Config.default();
     config.group_by_type = true;
     config.sort_alphabetical = true;
 
-    sortFiles(&files, config);
+    sortFiles(listing, config);
 
     // Files should be grouped by extension
-    try std.testing.expectEqualStrings("data.json", files[0].name);
-    try std.testing.expectEqualStrings("readme.md", files[1].name);
-    try std.testing.expectEqualStrings("script.sh", files[2].name);
+    try std.testing.expectEqualStrings("data.json", listing.name(listing.files[0]));
+    try std.testing.expectEqualStrings("readme.md", listing.name(listing.files[1]));
+    try std.testing.expectEqualStrings("script.sh", listing.name(listing.files[2]));
 }
 
 test "sortFiles - empty list" {
-    var files = [_]types.FileInfo{};
+    const listing = try types.Listing.fromSpecs(std.testing.allocator, &.{});
+    defer listing.deinit(std.testing.allocator);
 
     var config = types.Config.default();
     config.sort_alphabetical = true;
 
-    sortFiles(&files, config);
+    sortFiles(listing, config);
 
-    try std.testing.expectEqual(@as(usize, 0), files.len);
+    try std.testing.expectEqual(@as(usize, 0), listing.files.len);
 }
 
 test "sortFiles - single file" {
-    var files = [_]types.FileInfo{
+    const listing = try types.Listing.fromSpecs(std.testing.allocator, &.{
         .{
             .name = "only.txt",
             .mode = 0o644,
@@ -695,19 +1182,20 @@ test "sortFiles - single file" {
             .kind = .{ .file = .{ .executable = false } },
             .inode = 0,
         },
-    };
+    });
+    defer listing.deinit(std.testing.allocator);
 
     var config = types.Config.default();
     config.sort_alphabetical = true;
 
-    sortFiles(&files, config);
+    sortFiles(listing, config);
 
-    try std.testing.expectEqual(@as(usize, 1), files.len);
-    try std.testing.expectEqualStrings("only.txt", files[0].name);
+    try std.testing.expectEqual(@as(usize, 1), listing.files.len);
+    try std.testing.expectEqualStrings("only.txt", listing.name(listing.files[0]));
 }
 
 test "sortFiles - symlinks mixed with files and dirs" {
-    var files = [_]types.FileInfo{
+    const listing = try types.Listing.fromSpecs(std.testing.allocator, &.{
         .{
             .name = "regular.txt",
             .mode = 0o644,
@@ -741,21 +1229,22 @@ test "sortFiles - symlinks mixed with files and dirs" {
             .kind = .directory,
             .inode = 3,
         },
-    };
+    });
+    defer listing.deinit(std.testing.allocator);
 
     var config = types.Config.default();
     config.group_by_type = true;
     config.sort_alphabetical = true;
 
-    sortFiles(&files, config);
+    sortFiles(listing, config);
 
     // Directories first, then others sorted alphabetically
-    try std.testing.expect(files[0].kind == .directory);
-    try std.testing.expectEqualStrings("dir", files[0].name);
+    try std.testing.expect(listing.files[0].kind() == .directory);
+    try std.testing.expectEqualStrings("dir", listing.name(listing.files[0]));
 }
 
 test "sortFiles - files with same extension sorted alphabetically" {
-    var files = [_]types.FileInfo{
+    const listing = try types.Listing.fromSpecs(std.testing.allocator, &.{
         .{
             .name = "zebra.txt",
             .mode = 0o644,
@@ -789,22 +1278,23 @@ test "sortFiles - files with same extension sorted alphabetically" {
             .kind = .{ .file = .{ .executable = false } },
             .inode = 3,
         },
-    };
+    });
+    defer listing.deinit(std.testing.allocator);
 
     var config = types.Config.default();
     config.group_by_type = true;
     config.sort_alphabetical = true;
 
-    sortFiles(&files, config);
+    sortFiles(listing, config);
 
     // All have .txt extension, should be alphabetically sorted
-    try std.testing.expectEqualStrings("apple.txt", files[0].name);
-    try std.testing.expectEqualStrings("banana.txt", files[1].name);
-    try std.testing.expectEqualStrings("zebra.txt", files[2].name);
+    try std.testing.expectEqualStrings("apple.txt", listing.name(listing.files[0]));
+    try std.testing.expectEqualStrings("banana.txt", listing.name(listing.files[1]));
+    try std.testing.expectEqualStrings("zebra.txt", listing.name(listing.files[2]));
 }
 
 test "sortFiles - no extension files" {
-    var files = [_]types.FileInfo{
+    const listing = try types.Listing.fromSpecs(std.testing.allocator, &.{
         .{
             .name = "Makefile",
             .mode = 0o644,
@@ -827,51 +1317,380 @@ test "sortFiles - no extension files" {
             .kind = .{ .file = .{ .executable = false } },
             .inode = 2,
         },
-    };
+    });
+    defer listing.deinit(std.testing.allocator);
 
     var config = types.Config.default();
     config.group_by_type = true;
     config.sort_alphabetical = true;
 
-    sortFiles(&files, config);
+    sortFiles(listing, config);
 
     // Files without extension should still sort alphabetically
-    try std.testing.expectEqualStrings("Makefile", files[0].name);
-    try std.testing.expectEqualStrings("README", files[1].name);
+    try std.testing.expectEqualStrings("Makefile", listing.name(listing.files[0]));
+    try std.testing.expectEqualStrings("README", listing.name(listing.files[1]));
 }
 
 test "freeFileList - basic cleanup" {
     const allocator = std.testing.allocator;
 
+    const listing = try types.Listing.fromSpecs(allocator, &.{
+        .{ .name = "test1.txt", .size = 100, .mtime = 100, .inode = 1 },
+        .{ .name = "test2.txt", .size = 200, .mtime = 200, .inode = 2 },
+    });
+    freeFileList(allocator, listing);
+}
+
+test "listFiles - names share one arena, kinds come from the mode bits" {
+    const allocator = std.testing.allocator;
+    var tmp = std.testing.tmpDir(.{ .iterate = true });
+    defer tmp.cleanup();
+
+    try tmp.dir.writeFile(.{ .sub_path = "a.txt", .data = "abc" });
+    try tmp.dir.makeDir("sub");
+    const path = try tmp.dir.realpathAlloc(allocator, ".");
+    defer allocator.free(path);
+
+    var config = types.Config.default();
+    config.dir_path = path;
+    config.unsorted = true;
+    config.one_column = true; // Lazy: no stat at all, kind from d_type only
+
+    const listing = try listFiles(allocator, config);
+    defer freeFileList(allocator, listing);
+
+    try std.testing.expectEqual(@as(usize, 2), listing.files.len);
+    for (listing.files) |file| {
+        const name = listing.name(file);
+        const base = @intFromPtr(listing.names.ptr);
+        try std.testing.expect(@intFromPtr(name.ptr) >= base and @intFromPtr(name.ptr) < base + listing.names.len);
+        if (std.mem.eql(u8, name, "sub")) {
+            try std.testing.expect(file.kind() == .directory);
+        } else {
+            try std.testing.expectEqualStrings("a.txt", name);
+            try std.testing.expect(file.kind() == .file);
+        }
+    }
+}
+
+test "FilterSet - exact, ASCII miss and NFD/NFC equivalence" {
+    const allocator = std.testing.allocator;
+    // "café" composed (NFC, as a shell passes it) and "über" decomposed
+    var set = try FilterSet.init(allocator, &.{ "main.zig", "caf\u{e9}", "u\u{308}ber" });
+    defer set.deinit(allocator);
+
+    try std.testing.expect(set.contains("main.zig"));
+    try std.testing.expect(!set.contains("main.zi"));
+    try std.testing.expect(!set.contains("other.zig"));
+    // NFD name on disk (macOS) matches the NFC filter
+    try std.testing.expect(set.contains("cafe\u{301}"));
+    try std.testing.expect(set.contains("caf\u{e9}"));
+    // NFC name matches the NFD filter through its stored NFC form
+    try std.testing.expect(set.contains("\u{fc}ber"));
+    try std.testing.expect(!set.contains("caf\u{e8}"));
+}
+
+test "FilterSet - invalid UTF-8 still matches exactly" {
+    const allocator = std.testing.allocator;
+    var set = try FilterSet.init(allocator, &.{"bad\xff"});
+    defer set.deinit(allocator);
+
+    try std.testing.expect(set.contains("bad\xff"));
+    try std.testing.expect(!set.contains("bad\xfe"));
+}
+
+test "collectEntries - file filters" {
+    const allocator = std.testing.allocator;
+    var tmp = std.testing.tmpDir(.{ .iterate = true });
+    defer tmp.cleanup();
+
+    try tmp.dir.writeFile(.{ .sub_path = "keep.zig", .data = "" });
+    try tmp.dir.writeFile(.{ .sub_path = "drop.zig", .data = "" });
+
+    var config = types.Config.default();
+    const filters = [_][]const u8{ "keep.zig", "missing.zig" };
+    config.file_filters = &filters;
+
+    var names: types.NameArena = .{};
+    defer names.deinit(allocator);
+    const entries = try collectEntries(allocator, tmp.dir, config, &names);
+    defer allocator.free(entries);
+
+    try std.testing.expectEqual(@as(usize, 1), entries.len);
+    try std.testing.expectEqualStrings("keep.zig", names.get(entries[0].name));
+}
+
+test "collectEntries - patterns run before stat" {
+    const allocator = std.testing.allocator;
+    var tmp = std.testing.tmpDir(.{ .iterate = true });
+    defer tmp.cleanup();
+
+    try tmp.dir.writeFile(.{ .sub_path = "main.zig", .data = "" });
+    try tmp.dir.writeFile(.{ .sub_path = "TEST_a.ZIG", .data = "" });
+    try tmp.dir.writeFile(.{ .sub_path = "notes.md", .data = "" });
+    try tmp.dir.writeFile(.{ .sub_path = ".zigrc", .data = "" });
+
+    var config = types.Config.default();
+    const patterns = [_][]const u8{"*.zig"};
+    config.patterns = &patterns;
+    config.ignore_case = true;
+
+    var names: types.NameArena = .{};
+    defer names.deinit(allocator);
+    const entries = try collectEntries(allocator, tmp.dir, config, &names);
+    defer allocator.free(entries);
+
+    // Hidden files stay hidden; case folding picks up TEST_a.ZIG
+    try std.testing.expectEqual(@as(usize, 2), entries.len);
+    for (entries) |entry| {
+        try std.testing.expect(std.ascii.endsWithIgnoreCase(names.get(entry.name), ".zig"));
+    }
+}
+
+test "collectEntries - a dot pattern shows only the dotfiles it matches" {
+    const allocator = std.testing.allocator;
+    var tmp = std.testing.tmpDir(.{ .iterate = true });
+    defer tmp.cleanup();
+
+    try tmp.dir.writeFile(.{ .sub_path = ".bashrc", .data = "" });
+    try tmp.dir.writeFile(.{ .sub_path = ".foo.zig", .data = "" });
+    try tmp.dir.writeFile(.{ .sub_path = "main.zig", .data = "" });
+
+    var config = types.Config.default();
+    const patterns = [_][]const u8{ ".*rc", "*.zig" };
+    config.patterns = &patterns;
+
+    var names: types.NameArena = .{};
+    defer names.deinit(allocator);
+    const entries = try collectEntries(allocator, tmp.dir, config, &names);
+    defer allocator.free(entries);
+
+    try std.testing.expectEqual(@as(usize, 2), entries.len);
+    for (entries) |entry| {
+        try std.testing.expect(!std.mem.eql(u8, names.get(entry.name), ".foo.zig"));
+    }
+}
+
+test "streamFiles - emits bounded chunks in directory order" {
+    const allocator = std.testing.allocator;
+    var tmp = std.testing.tmpDir(.{ .iterate = true });
+    defer tmp.cleanup();
+
+    const count = STREAM_CHUNK + 10;
+    for (0..count) |i| {
+        var name_buf: [16]u8 = undefined;
+        try tmp.dir.writeFile(.{ .sub_path = try std.fmt.bufPrint(&name_buf, "f{d}", .{i}), .data = "" });
+    }
+    const path = try tmp.dir.realpathAlloc(allocator, ".");
+    defer allocator.free(path);
+
+    var config = types.Config.default();
+    config.dir_path = path;
+    config.unsorted = true;
+    config.output_format = .porcelain;
+    try std.testing.expect(canStream(config));
+
+    const Sink = struct {
+        chunks: usize = 0,
+        total: usize = 0,
+        max_chunk: usize = 0,
+
+        pub fn emit(self: *@This(), chunk: types.Listing) !void {
+            self.chunks += 1;
+            self.total += chunk.files.len;
+            self.max_chunk = @max(self.max_chunk, chunk.files.len);
+            for (chunk.files) |file| try std.testing.expect(chunk.name(file)[0] == 'f');
+        }
+    };
+    var sink: Sink = .{};
+    try streamFiles(allocator, config, &sink);
+
+    try std.testing.expectEqual(@as(usize, count), sink.total);
+    try std.testing.expectEqual(@as(usize, 2), sink.chunks);
+    try std.testing.expectEqual(STREAM_CHUNK, sink.max_chunk);
+}
+
+test "canStream - only unsorted listings without -d" {
+    var config = types.Config.default();
+    try std.testing.expect(!canStream(config));
+    config.unsorted = true;
+    try std.testing.expect(canStream(config));
+    config.calc_dir_sizes = true;
+    try std.testing.expect(!canStream(config));
+}
+
+test "kindFromMode - maps type bits" {
+    const S = std.posix.S;
+    try std.testing.expectEqual(std.fs.Dir.Entry.Kind.directory, kindFromMode(S.IFDIR | 0o755));
+    try std.testing.expectEqual(std.fs.Dir.Entry.Kind.sym_link, kindFromMode(S.IFLNK | 0o777));
+    try std.testing.expectEqual(std.fs.Dir.Entry.Kind.file, kindFromMode(S.IFREG | 0o644));
+    try std.testing.expectEqual(std.fs.Dir.Entry.Kind.unknown, kindFromMode(S.IFIFO | 0o644));
+}
+
+test "collectEntries - getdents data only, filters applied" {
+    const allocator = std.testing.allocator;
+    var tmp = std.testing.tmpDir(.{ .iterate = true });
+    defer tmp.cleanup();
+
+    try tmp.dir.writeFile(.{ .sub_path = "visible.txt", .data = "" });
+    try tmp.dir.writeFile(.{ .sub_path = ".hidden", .data = "" });
+    try tmp.dir.makeDir("sub");
+
+    var names: types.NameArena = .{};
+    defer names.deinit(allocator);
+    const entries = try collectEntries(allocator, tmp.dir, types.Config.default(), &names);
+    defer allocator.free(entries);
+
+    try std.testing.expectEqual(@as(usize, 2), entries.len);
+    for (entries) |entry| try std.testing.expect(names.get(entry.name)[0] != '.');
+}
+
+test "appendFileInfos - -i shows the stat inode" {
+    const allocator = std.testing.allocator;
+    var tmp = std.testing.tmpDir(.{});
+    defer tmp.cleanup();
+    try tmp.dir.writeFile(.{ .sub_path = "f", .data = "" });
+
+    var names: types.NameArena = .{};
+    defer names.deinit(allocator);
+    const entries = [_]DirEntry{.{ .name = try names.append(allocator, "f"), .kind = .file }};
+    var stats: [entries.len]?metadata.Stat = undefined;
+    var config = types.Config.default();
+    config.show_inodes = true;
+    collectMetadata(allocator, tmp.dir.fd, &entries, names.bytes.items, metadata.Fields.fromConfig(config), &stats, config);
+
     var list: std.ArrayList(types.FileInfo) = .empty;
     defer list.deinit(allocator);
+    try appendFileInfos(allocator, &list, &entries, &stats, null);
+    const st = try std.posix.fstatat(tmp.dir.fd, "f", std.posix.AT.SYMLINK_NOFOLLOW);
+    try std.testing.expectEqual(@as(u64, @intCast(st.ino)), list.items[0].inode);
+}
 
-    try list.append(allocator, .{
-        .name = try allocator.dupe(u8, "test1.txt"),
-        .mode = 0o644,
-        .size = 100,
-        .mtime = 100,
-        .uid = 0,
-        .gid = 0,
-        .git_status = .clean,
-        .kind = .{ .file = .{ .executable = false } },
-        .inode = 1,
-    });
+test "collectMetadata - lazy mode issues no stat for known d_type" {
+    // Names don't exist on disk: any stat call would fail and yield null
+    const allocator = std.testing.allocator;
+    var names: types.NameArena = .{};
+    defer names.deinit(allocator);
+    const entries = [_]DirEntry{
+        .{ .name = try names.append(allocator, "ghost.txt"), .kind = .file },
+        .{ .name = try names.append(allocator, "ghost_dir"), .kind = .directory },
+    };
+    var stats: [entries.len]?metadata.Stat = undefined;
+
+    collectMetadata(allocator, std.fs.cwd().fd, &entries, names.bytes.items, .{}, &stats, types.Config.default());
+
+    for (stats) |st| try std.testing.expect(st != null);
+}
+
+test "statWorkerCount - auto mode stays serial below threshold" {
+    try std.testing.expectEqual(@as(usize, 1), statWorkerCount(0, 10, .{}, .auto));
+    try std.testing.expectEqual(@as(usize, 1), statWorkerCount(0, PARALLEL_STAT_THRESHOLD - 1, .{}, .auto));
+}
+
+test "statWorkerCount - explicit jobs win, bounded by chunks and max" {
+    try std.testing.expectEqual(@as(usize, 4), statWorkerCount(4, 10_000, .{}, .auto));
+    // 300 entries are only two chunks
+    try std.testing.expectEqual(@as(usize, 2), statWorkerCount(8, 300, .{}, .auto));
+    try std.testing.expectEqual(MAX_STAT_JOBS, statWorkerCount(1000, 1_000_000, .{}, .auto));
+}
+
+test "statWorkerCount - network filesystems get more workers" {
+    try std.testing.expectEqual(AUTO_JOBS_NETWORK, statWorkerCount(0, 100_000, .{ .dont_sync = true }, .auto));
+}
+
+test "statWorkerCount - forced backends" {
+    // serial ignores --jobs; threads ignores the auto threshold
+    try std.testing.expectEqual(@as(usize, 1), statWorkerCount(8, 10_000, .{}, .serial));
+    try std.testing.expectEqual(AUTO_JOBS_NETWORK, statWorkerCount(0, 100 * STAT_CHUNK_SIZE, .{ .dont_sync = true }, .threads));
+}
+
+test "collectMetadata - every backend matches serial order" {
+    const allocator = std.testing.allocator;
+    var tmp = std.testing.tmpDir(.{ .iterate = true });
+    defer tmp.cleanup();
+
+    // Distinct sizes so a misplaced slot is detectable
+    const count = 3 * STAT_CHUNK_SIZE + 7;
+    var names: types.NameArena = .{};
+    defer names.deinit(allocator);
+    var entries: [count]DirEntry = undefined;
+    for (&entries, 0..) |*entry, i| {
+        var name_buf: [16]u8 = undefined;
+        const name = try std.fmt.bufPrint(&name_buf, "f{d}", .{i});
+        const data = try allocator.alloc(u8, i);
+        defer allocator.free(data);
+        @memset(data, 'x');
+        try tmp.dir.writeFile(.{ .sub_path = name, .data = data });
+        entry.* = .{ .name = try names.append(allocator, name), .kind = .file };
+    }
+
+    var config = types.Config.default();
+    for ([_]types.StatBackend{ .serial, .threads, .io_uring }) |backend| {
+        config.stat_backend = backend;
+        config.jobs = if (backend == .threads) 4 else 0;
+
+        var stats: [count]?metadata.Stat = undefined;
+        collectMetadata(allocator, tmp.dir.fd, &entries, names.bytes.items, .{ .size = true }, &stats, config);
+
+        for (stats, 0..) |st, i| {
+            try std.testing.expectEqual(@as(u64, i), st.?.size);
+        }
+    }
+}
 
-    try list.append(allocator, .{
-        .name = try allocator.dupe(u8, "test2.txt"),
-        .mode = 0o644,
-        .size = 200,
-        .mtime = 200,
-        .uid = 0,
-        .gid = 0,
-        .git_status = .clean,
-        .kind = .{ .file = .{ .executable = false } },
-        .inode = 2,
+test "calculateDirSizes - sums and states land on their rows" {
+    const allocator = std.testing.allocator;
+    var tmp = std.testing.tmpDir(.{ .iterate = true });
+    defer tmp.cleanup();
+    try tmp.dir.makePath("a/sub");
+    try tmp.dir.makePath("b");
+    try tmp.dir.writeFile(.{ .sub_path = "a/sub/f", .data = "x" ** 9000 });
+    try tmp.dir.writeFile(.{ .sub_path = "file", .data = "" });
+
+    var config = types.Config.default();
+    config.calc_dir_sizes = true;
+    config.dir_path = try tmp.dir.realpathAlloc(allocator, ".");
+    defer allocator.free(config.dir_path);
+
+    const listing = try types.Listing.fromSpecs(allocator, &.{
+        .{ .name = "b", .kind = .directory },
+        .{ .name = "file", .size = 7 },
+        .{ .name = ".", .kind = .directory },
+        .{ .name = "a", .kind = .directory },
     });
+    defer listing.deinit(allocator);
+
+    var counts: types.TreeCounts = .empty;
+    defer counts.deinit(allocator);
+    try calculateDirSizes(allocator, listing, config, &counts);
+    for (listing.files) |file| try std.testing.expectEqual(types.FileInfo.SizeState.exact, file.size_state);
+    try std.testing.expectEqual(@as(u64, 7), listing.files[1].size); // Files untouched
+    try std.testing.expect(listing.files[3].size > listing.files[0].size);
+    try std.testing.expect(listing.files[2].size >= listing.files[0].size + listing.files[3].size);
+
+    // Counts sit beside the listing, found by name through any reordering
+    var counted = listing;
+    counted.counts = &counts;
+    try std.testing.expectEqual(types.TreeCount{ .files = 1, .dirs = 1 }, counted.count(listing.files[3]).?);
+    try std.testing.expectEqual(types.TreeCount{ .files = 0, .dirs = 0 }, counted.count(listing.files[0]).?);
+    try std.testing.expectEqual(types.TreeCount{ .files = 2, .dirs = 3 }, counted.count(listing.files[2]).?);
+    try std.testing.expect(counted.count(listing.files[1]) == null);
+
+    // A spent budget: no row is left pending, cut rows are lower bounds
+    const exact = [_]u64{ listing.files[0].size, listing.files[3].size };
+    config.size_budget_ns = 0;
+    try calculateDirSizes(allocator, listing, config, null);
+    for ([_]usize{ 0, 3 }, exact) |i, size| {
+        try std.testing.expect(listing.files[i].size_state != .pending);
+        try std.testing.expect(listing.files[i].size <= size);
+    }
 
-    const files = try list.toOwnedSlice(allocator);
-    freeFileList(allocator, files);
+    // --size-mode=apparent: st_size sums from the same walk
+    config.size_budget_ns = null;
+    config.size_mode = .apparent;
+    try calculateDirSizes(allocator, listing, config, null);
+    try std.testing.expect(listing.files[3].size >= 9000);
+    try std.testing.expect(listing.files[2].size >= listing.files[3].size);
 }
 
 test "listFiles - test directory listing" {
@@ -883,15 +1702,15 @@ test "listFiles - test directory listing" {
     // var config = types.Config.default();
     // config.dir_path = ".";
 
-    // const files = try listFiles(allocator, config, null);
-    // defer freeFileList(allocator, files);
+    // const listing = try listFiles(allocator, config);
+    // defer freeFileList(allocator, listing);
 
     // // Should have at least one file in current directory
-    // try std.testing.expect(files.len > 0);
+    // try std.testing.expect(listing.files.len > 0);
 
     // // Verify we got FileInfo structs
-    // for (files) |file| {
-    //     try std.testing.expect(file.name.len > 0);
+    // for (listing.files) |file| {
+    //     try std.testing.expect(listing.name(file).len > 0);
     // }
 }
 
@@ -905,19 +1724,19 @@ test "listFiles - with show_all flag" {
     // config.dir_path = ".";
     // config.show_all = false;
 
-    // const files_no_hidden = try listFiles(allocator, config, null);
+    // const files_no_hidden = try listFiles(allocator, config);
     // defer freeFileList(allocator, files_no_hidden);
 
     // config.show_all = true;
-    // const files_with_hidden = try listFiles(allocator, config, null);
+    // const files_with_hidden = try listFiles(allocator, config);
     // defer freeFileList(allocator, files_with_hidden);
 
     // // With show_all, we should get same or more files
-    // try std.testing.expect(files_with_hidden.len >= files_no_hidden.len);
+    // try std.testing.expect(files_with_hidden.files.len >= files_no_hidden.files.len);
 }
 
 test "sortFiles - sort by extension (-X)" {
-    var files = [_]types.FileInfo{
+    const listing = try types.Listing.fromSpecs(std.testing.allocator, &.{
         .{
             .name = "file.txt",
             .mode = 0o644,
@@ -973,24 +1792,25 @@ test "sortFiles - sort by extension (-X)" {
             .kind = .{ .file = .{ .executable = false } },
             .inode = 5,
         },
-    };
+    });
+    defer listing.deinit(std.testing.allocator);
 
     var config = types.Config.default();
     config.sort_by_extension = true;
 
-    sortFiles(&files, config);
+    sortFiles(listing, config);
 
     // Files without extension should come first, then sorted by extension
     // Expected order: Makefile, README (no extension), data.json (.json), script.sh (.sh), file.txt (.txt)
-    try std.testing.expectEqualStrings("Makefile", files[0].name);
-    try std.testing.expectEqualStrings("README", files[1].name);
-    try std.testing.expectEqualStrings("data.json", files[2].name);
-    try std.testing.expectEqualStrings("script.sh", files[3].name);
-    try std.testing.expectEqualStrings("file.txt", files[4].name);
+    try std.testing.expectEqualStrings("Makefile", listing.name(listing.files[0]));
+    try std.testing.expectEqualStrings("README", listing.name(listing.files[1]));
+    try std.testing.expectEqualStrings("data.json", listing.name(listing.files[2]));
+    try std.testing.expectEqualStrings("script.sh", listing.name(listing.files[3]));
+    try std.testing.expectEqualStrings("file.txt", listing.name(listing.files[4]));
 }
 
 test "sortFiles - sort by extension with same extension" {
-    var files = [_]types.FileInfo{
+    const listing = try types.Listing.fromSpecs(std.testing.allocator, &.{
         .{
             .name = "zebra.txt",
             .mode = 0o644,
@@ -1024,15 +1844,16 @@ test "sortFiles - sort by extension with same extension" {
             .kind = .{ .file = .{ .executable = false } },
             .inode = 3,
         },
-    };
+    });
+    defer listing.deinit(std.testing.allocator);
 
     var config = types.Config.default();
     config.sort_by_extension = true;
 
-    sortFiles(&files, config);
+    sortFiles(listing, config);
 
     // Within same extension, should be alphabetically sorted
-    try std.testing.expectEqualStrings("apple.txt", files[0].name);
-    try std.testing.expectEqualStrings("banana.txt", files[1].name);
-    try std.testing.expectEqualStrings("zebra.txt", files[2].name);
+    try std.testing.expectEqualStrings("apple.txt", listing.name(listing.files[0]));
+    try std.testing.expectEqualStrings("banana.txt", listing.name(listing.files[1]));
+    try std.testing.expectEqualStrings("zebra.txt", listing.name(listing.files[2]));
 }
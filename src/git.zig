@@ -1,81 +1,159 @@
 const std = @import("std");
 const types = @import("types.zig");
+const git_index = @import("git_index.zig");
 
 pub const GitContext = struct {
     allocator: std.mem.Allocator,
     statuses: std.StringHashMap(types.FileInfo.GitStatus),
     rel_prefix: []const u8,
+    /// Most urgent status under each top-level directory (first path
+    /// component), folded in while parsing so directory lookups are O(1)
+    dir_statuses: std.StringHashMapUnmanaged(types.FileInfo.GitStatus) = .empty,
+    /// Backing bytes for the keys of both maps: bump-allocated, freed at once
+    keys: std.heap.ArenaAllocator.State = .{},
+    /// Git was stopped before it answered: every entry reports .unknown
+    degraded: bool = false,
+    /// From the "# branch.*" headers, when GitOptions.branch asked for them
+    branch: Branch = .{},
 
     /// Initialize GitContext by loading git status for the given directory.
     /// Returns error if not a git repository or git command fails.
-    pub fn init(allocator: std.mem.Allocator, dir_path: []const u8) !GitContext {
+    /// Firing `cancel` from another thread makes a running load fail promptly.
+    pub fn init(allocator: std.mem.Allocator, dir_path: []const u8, options: types.GitOptions, cancel: ?*Cancel) !GitContext {
         var self = GitContext{
             .allocator = allocator,
             .statuses = std.StringHashMap(types.FileInfo.GitStatus).init(allocator),
             .rel_prefix = &.{},
         };
+        errdefer self.deinit();
 
-        // Load git status - git itself will handle if not a repo
-        try self.load(dir_path);
+        // Find the repository in-process, once: outside one there is no git
+        // to spawn, and both the index check and git reuse what was found
+        var path_buf: [std.fs.max_path_bytes]u8 = undefined;
+        const worktree = (try git_index.discover(&path_buf, dir_path)) orelse return error.NotAGitRepository;
+
+        // A clean subtree can be proven from .git/index without forking git
+        // (empty statuses = everything clean). Branch headers need git.
+        if (!options.branch and git_index.provesClean(allocator, worktree, if (cancel) |c| &c.cancelled else null)) return self;
+
+        // Porcelain paths are relative to the worktree root, even with the
+        // "." pathspec; record() strips this prefix to get listing names
+        self.rel_prefix = try self.internKey(worktree.prefix());
+
+        try self.load(worktree.path, options, cancel);
         return self;
     }
 
     pub fn deinit(self: *GitContext) void {
-        // Free all keys in the hashmap (they are duplicated strings)
-        var it = self.statuses.keyIterator();
-        while (it.next()) |key| {
-            self.allocator.free(key.*);
-        }
         self.statuses.deinit();
+        self.dir_statuses.deinit(self.allocator);
+        // All keys live in the key arena
+        self.keys.promote(self.allocator).deinit();
     }
 
-    /// Execute `git status --porcelain=v2` and parse output into hash map
-    fn load(self: *GitContext, dir_path: []const u8) !void {
-        var child = std.process.Child.init(
-            &.{ "git", "status", "--porcelain=v2" },
-            self.allocator,
-        );
-        // TODO: Add environment variable isolation for security
-        // (requires inheriting current env + adding security vars)
+    /// Execute `git status --porcelain=v2 -z -- .` and parse output into hash map.
+    /// The "." pathspec limits git's scan to the listed directory's subtree,
+    /// which still covers every path the immediate children aggregate over.
+    fn load(self: *GitContext, dir_path: []const u8, options: types.GitOptions, cancel: ?*Cancel) !void {
+        var argv_buf: [max_status_args][]const u8 = undefined;
+        var child = std.process.Child.init(statusArgv(&argv_buf, options), self.allocator);
+        var env = try childEnv(self.allocator);
+        defer env.deinit();
+        child.env_map = &env;
         child.cwd = dir_path;
         child.stdout_behavior = .Pipe;
         child.stderr_behavior = .Ignore;
 
         try child.spawn();
-
-        // Read stdout (blocks until process completes or pipe closes)
-        // Git has its own timeout mechanisms, no need for manual timeout
-        const stdout = try child.stdout.?.readToEndAlloc(self.allocator, types.GIT_STATUS_MAX_OUTPUT);
-        defer self.allocator.free(stdout);
-
-        // Wait for process to complete
+        // Don't leave git running (or a zombie) if parsing fails midway
+        errdefer _ = child.kill() catch {};
+        // From here a cancel SIGKILLs git, which ends its output early
+        if (cancel) |c| c.attach(child.id);
+        errdefer if (cancel) |c| c.detach();
+
+        // Parse records as git writes them: memory holds one read buffer
+        // rather than the whole output, there is no output size limit, and
+        // parsing overlaps git's own scan
+        var buffer: [types.GIT_STATUS_BUFFER_SIZE]u8 = undefined;
+        var stdout = child.stdout.?.readerStreaming(&buffer);
+        try self.parseStream(&stdout.interface);
+
+        // Detach before reaping, so a late cancel can't signal a reused pid
+        if (cancel) |c| c.detach();
         const result = try child.wait();
+        if (cancel) |c| if (c.isCancelled()) return error.Cancelled;
         switch (result) {
             .Exited => |code| if (code != 0) return error.GitCommandFailed,
             else => return error.GitCommandFailed,
         }
+    }
 
-        // Parse porcelain v2 format
-        var lines = std.mem.splitScalar(u8, stdout, '\n');
-        while (lines.next()) |line| {
+    /// Parse NUL-separated porcelain v2 records until end of stream. Paths are
+    /// raw bytes: -z turns off git's C-style quoting of names with spaces,
+    /// quotes or non-ASCII. Each record is consumed before the next is read,
+    /// so only the reader's buffer is held.
+    fn parseStream(self: *GitContext, reader: *std.Io.Reader) !void {
+        while (true) {
+            const line = takeRecord(reader) catch |err| switch (err) {
+                error.EndOfStream => return,
+                else => |e| return e,
+            };
             if (line.len == 0) continue;
 
-            if (line[0] == '1' or line[0] == '2') {
+            switch (line[0]) {
                 // Tracked file entry
-                try self.parseTrackedFile(line);
-            } else if (line[0] == '?') {
+                '1' => try self.parseTrackedFile(line),
+                // Rename/copy: the source path follows as its own record
+                '2' => {
+                    try self.parseTrackedFile(line);
+                    _ = takeRecord(reader) catch |err| switch (err) {
+                        error.EndOfStream => return error.InvalidFormat,
+                        else => |e| return e,
+                    };
+                },
                 // Untracked file entry
-                try self.parseUntrackedFile(line);
+                '?' => try self.parseUntrackedFile(line),
+                // Header: "# branch.head main", "# branch.ab +1 -0", ...
+                '#' => try self.parseHeader(line),
+                // Ignore other records ('u' unmerged, '!' ignored)
+                else => {},
             }
-            // Ignore other lines (e.g., '# branch.oid ...', '# branch.head ...', etc.)
-            // This is safe - git porcelain v2 format specifies these are metadata lines
+        }
+    }
+
+    /// Next NUL-terminated record, without the NUL. Valid until the next read.
+    fn takeRecord(reader: *std.Io.Reader) ![]const u8 {
+        const line = try reader.takeDelimiterInclusive(0);
+        return line[0 .. line.len - 1];
+    }
+
+    /// Parse a "# branch.<key> <value>" header. Unknown headers (branch.oid,
+    /// stash counts) are skipped.
+    fn parseHeader(self: *GitContext, line: []const u8) !void {
+        var iter = std.mem.splitScalar(u8, line, ' ');
+        _ = iter.next(); // Skip "#"
+        const key = iter.next() orelse return error.InvalidFormat;
+        const value = iter.rest();
+
+        if (std.mem.eql(u8, key, "branch.head")) {
+            self.branch.head = try self.internKey(value);
+        } else if (std.mem.eql(u8, key, "branch.upstream")) {
+            self.branch.upstream = try self.internKey(value);
+        } else if (std.mem.eql(u8, key, "branch.ab")) {
+            // "+<ahead> -<behind>"
+            var counts = std.mem.splitScalar(u8, value, ' ');
+            const ahead = counts.next() orelse return error.InvalidFormat;
+            const behind = counts.next() orelse return error.InvalidFormat;
+            if (ahead.len < 2 or ahead[0] != '+' or behind.len < 2 or behind[0] != '-') return error.InvalidFormat;
+            self.branch.ahead = std.fmt.parseInt(u32, ahead[1..], 10) catch return error.InvalidFormat;
+            self.branch.behind = std.fmt.parseInt(u32, behind[1..], 10) catch return error.InvalidFormat;
         }
     }
 
     /// Parse tracked file line: "1 XY sub <mH> <mI> <mW> <hH> <hI> <path>"
+    /// or rename/copy line: "2 XY sub <mH> <mI> <mW> <hH> <hI> <Xscore> <path>"
     fn parseTrackedFile(self: *GitContext, line: []const u8) !void {
-        // Format: "1 XY sub ...fields... path"
-        // We need: XY (2 chars) and path (everything after 8th field)
+        // We need: XY (2 chars) and path (everything after the fixed fields)
 
         var iter = std.mem.splitScalar(u8, line, ' ');
         _ = iter.next(); // Skip "1" or "2"
@@ -83,10 +161,12 @@ pub const GitContext = struct {
         const xy = iter.next() orelse return error.InvalidFormat;
         if (xy.len < 2) return error.InvalidFormat;
 
-        // Skip exactly 6 more fields (sub, mH, mI, mW, hH, hI)
-        // Then everything remaining is the path (which may contain spaces)
+        // Skip exactly 6 more fields (sub, mH, mI, mW, hH, hI), plus the
+        // rename score for '2' lines. Everything remaining is the path
+        // (which may contain spaces)
+        const skip: usize = if (line[0] == '2') 7 else 6;
         var i: usize = 0;
-        while (i < 6) : (i += 1) {
+        while (i < skip) : (i += 1) {
             _ = iter.next() orelse return error.InvalidFormat;
         }
 
@@ -96,19 +176,82 @@ pub const GitContext = struct {
 
         const status = parseStatusChars(xy[0], xy[1]);
 
-        // Duplicate the path string since git output will be freed
-        const owned_path = try self.allocator.dupe(u8, final_path);
-        try self.statuses.put(owned_path, status);
+        try self.record(final_path, status);
     }
 
     /// Parse untracked file line: "? <path>"
     fn parseUntrackedFile(self: *GitContext, line: []const u8) !void {
-        const path = std.mem.trim(u8, line[1..], &std.ascii.whitespace);
-        if (path.len == 0) return error.InvalidFormat;
+        // With -z the path is taken verbatim; leading/trailing spaces are part of the name
+        if (line.len < 3 or line[1] != ' ') return error.InvalidFormat;
+        const path = line[2..];
 
-        // Duplicate the path string since git output will be freed
-        const owned_path = try self.allocator.dupe(u8, path);
-        try self.statuses.put(owned_path, .untracked);
+        try self.record(path, .untracked);
+    }
+
+    /// Store a parsed path's status under the key the listing will look up.
+    /// Once made relative to the listed directory, a child's own name
+    /// ("dir/" for an untracked directory git collapsed, "./") is kept as is;
+    /// anything deeper only updates its top-level directory's aggregate.
+    /// Keys are copied once into the key arena: no per-path allocation, and
+    /// hashing covers short names rather than full repository paths.
+    fn record(self: *GitContext, repo_path: []const u8, status: types.FileInfo.GitStatus) !void {
+        const path = self.relativePath(repo_path) orelse return;
+        if (std.mem.indexOfScalar(u8, path, '/')) |slash| {
+            if (slash + 1 < path.len) {
+                const dir = try self.dir_statuses.getOrPut(self.allocator, path[0..slash]);
+                if (!dir.found_existing) {
+                    dir.key_ptr.* = self.internKey(path[0..slash]) catch |err| {
+                        self.dir_statuses.removeByPtr(dir.key_ptr);
+                        return err;
+                    };
+                    dir.value_ptr.* = status;
+                } else if (priority(status) > priority(dir.value_ptr.*)) {
+                    dir.value_ptr.* = status;
+                }
+                return;
+            }
+        }
+
+        const entry = try self.statuses.getOrPut(path);
+        if (!entry.found_existing) {
+            entry.key_ptr.* = self.internKey(path) catch |err| {
+                self.statuses.removeByPtr(entry.key_ptr);
+                return err;
+            };
+        }
+        entry.value_ptr.* = status;
+    }
+
+    /// A worktree-relative path as seen from the listed directory. An
+    /// untracked directory at or above the listed one becomes "./".
+    fn relativePath(self: *const GitContext, repo_path: []const u8) ?[]const u8 {
+        const prefix = self.rel_prefix;
+        if (prefix.len == 0) return repo_path;
+        if (std.mem.startsWith(u8, repo_path, prefix) and repo_path.len > prefix.len and repo_path[prefix.len] == '/') {
+            const rest = repo_path[prefix.len + 1 ..];
+            return if (rest.len == 0) "./" else rest;
+        }
+        // "? a/" while listing a/b: the whole listed directory is untracked
+        if (std.mem.endsWith(u8, repo_path, "/") and std.mem.startsWith(u8, prefix, repo_path)) return "./";
+        return null;
+    }
+
+    /// Copy a key into the key arena (the parsed record is overwritten by the next read)
+    fn internKey(self: *GitContext, key: []const u8) ![]const u8 {
+        var arena = self.keys.promote(self.allocator);
+        defer self.keys = arena.state;
+        return arena.allocator().dupe(u8, key);
+    }
+
+    /// Which status a directory shows when its contents disagree:
+    /// unstaged > staged > untracked
+    fn priority(status: types.FileInfo.GitStatus) u8 {
+        return switch (status) {
+            .unstaged_modified, .unstaged_added, .unstaged_deleted, .unstaged_renamed, .unstaged_copied => 3,
+            .staged_modified, .staged_added, .staged_deleted, .staged_renamed, .staged_copied => 2,
+            .untracked => 1,
+            else => 0,
+        };
     }
 
     /// Convert git status XY codes to our GitStatus enum
@@ -144,6 +287,8 @@ pub const GitContext = struct {
     /// Returns .clean if file not found in git status.
     /// For directories, checks if any files inside have changes.
     pub fn getStatus(self: *const GitContext, filename: []const u8, is_dir: bool) types.FileInfo.GitStatus {
+        if (self.degraded) return .unknown;
+
         // Try exact match first
         if (self.statuses.get(filename)) |status| {
             return status;
@@ -158,8 +303,8 @@ pub const GitContext = struct {
                 return status;
             }
 
-            // Check if any files inside the directory have changes
-            return self.checkDirForChanges(filename);
+            // Most urgent change anywhere inside the directory
+            return self.dir_statuses.get(filename) orelse .clean;
         }
 
         // Check if current directory itself is untracked (./)
@@ -174,38 +319,208 @@ pub const GitContext = struct {
         return .clean;
     }
 
-    /// Check if a directory contains any files with git changes
-    /// Returns the most "urgent" status found (unstaged > staged > untracked)
-    fn checkDirForChanges(self: *const GitContext, dir_path: []const u8) types.FileInfo.GitStatus {
-        var best_status: types.FileInfo.GitStatus = .clean;
-        var priority: u8 = 0; // 0=none, 1=staged, 2=untracked, 3=unstaged
-
-        // Create prefix to match files in this directory
-        var prefix_buf: [std.fs.max_path_bytes]u8 = undefined;
-        const prefix = std.fmt.bufPrint(&prefix_buf, "{s}/", .{dir_path}) catch return .clean;
-
-        // Iterate through all git entries to find matches
-        var iter = self.statuses.iterator();
-        while (iter.next()) |entry| {
-            if (std.mem.startsWith(u8, entry.key_ptr.*, prefix)) {
-                const status = entry.value_ptr.*;
-
-                // Determine priority of this status (unstaged > staged > untracked)
-                const current_priority: u8 = switch (status) {
-                    .unstaged_modified, .unstaged_added, .unstaged_deleted, .unstaged_renamed, .unstaged_copied => 3,
-                    .staged_modified, .staged_added, .staged_deleted, .staged_renamed, .staged_copied => 2,
-                    .untracked => 1,
-                    else => 0,
-                };
+    /// Fill in git_status for every entry of a listing in one pass, after
+    /// enumeration rather than inside it. The "." entry from -d stays clean.
+    pub fn annotate(self: *const GitContext, listing: types.Listing) void {
+        for (listing.files) |*file| {
+            const name = listing.name(file.*);
+            if (std.mem.eql(u8, name, ".")) continue;
+            file.git_status = self.getStatus(name, file.isDir());
+        }
+    }
+};
 
-                if (current_priority > priority) {
-                    best_status = status;
-                    priority = current_priority;
-                }
+const max_status_args = 11;
+
+/// `git status` command line for these options. Always read-only:
+/// --no-optional-locks stops git from refreshing the index and taking
+/// index.lock, so lg never contends with (or fails) commits made by IDEs and
+/// CI in the same checkout.
+fn statusArgv(buf: *[max_status_args][]const u8, options: types.GitOptions) []const []const u8 {
+    var len: usize = 0;
+    for ([_][]const u8{ "git", "--no-optional-locks", "status", "--porcelain=v2", "-z" }) |arg| {
+        buf[len] = arg;
+        len += 1;
+    }
+    if (options.branch) {
+        buf[len] = "--branch";
+        len += 1;
+    }
+    if (options.renames) |renames| {
+        buf[len] = if (renames) "--renames" else "--no-renames";
+        len += 1;
+    }
+    if (options.untracked) |mode| {
+        buf[len] = switch (mode) {
+            inline else => |m| "--untracked-files=" ++ @tagName(m),
+        };
+        len += 1;
+    }
+    if (options.submodules) |mode| {
+        buf[len] = switch (mode) {
+            inline else => |m| "--ignore-submodules=" ++ @tagName(m),
+        };
+        len += 1;
+    }
+    buf[len] = "--";
+    buf[len + 1] = ".";
+    return buf[0 .. len + 2];
+}
+
+/// Variables git needs to find itself, its config and the repository.
+/// Nothing else is inherited (no GIT_TRACE*, pagers, editors, askpass).
+const passthrough_env = [_][]const u8{
+    "PATH",
+    "HOME",
+    "XDG_CONFIG_HOME",
+    "GIT_DIR",
+    "GIT_WORK_TREE",
+    "GIT_INDEX_FILE",
+    "GIT_COMMON_DIR",
+    "GIT_OBJECT_DIRECTORY",
+    "GIT_ALTERNATE_OBJECT_DIRECTORIES",
+    "GIT_CEILING_DIRECTORIES",
+    "GIT_DISCOVERY_ACROSS_FILESYSTEM",
+    "GIT_CONFIG_GLOBAL",
+    "GIT_CONFIG_SYSTEM",
+    "GIT_CONFIG_NOSYSTEM",
+};
+
+/// Minimal environment for the git child: the passthrough set, optional
+/// locks off (also covers nested git processes such as submodule status),
+/// no credential prompts, and the C locale.
+fn childEnv(allocator: std.mem.Allocator) !std.process.EnvMap {
+    var env = std.process.EnvMap.init(allocator);
+    errdefer env.deinit();
+    for (passthrough_env) |name| {
+        if (std.posix.getenv(name)) |value| try env.put(name, value);
+    }
+    try env.put("GIT_OPTIONAL_LOCKS", "0");
+    try env.put("GIT_TERMINAL_PROMPT", "0");
+    try env.put("LC_ALL", "C");
+    return env;
+}
+
+/// Branch metadata from porcelain v2 headers. `upstream` is null when no
+/// upstream is configured; ahead/behind are 0 then (and when it is gone).
+pub const Branch = struct {
+    head: ?[]const u8 = null, // "(detached)" on a detached HEAD
+    upstream: ?[]const u8 = null,
+    ahead: u32 = 0,
+    behind: u32 = 0,
+
+    /// "main → origin/main (ahead 2, behind 1)"; nothing without a head.
+    pub fn write(self: Branch, writer: *std.Io.Writer) !void {
+        const head = self.head orelse return;
+        try writer.writeAll(head);
+        const upstream = self.upstream orelse return;
+        try writer.print(" → {s}", .{upstream});
+        if (self.ahead > 0 and self.behind > 0) {
+            try writer.print(" (ahead {d}, behind {d})", .{ self.ahead, self.behind });
+        } else if (self.ahead > 0) {
+            try writer.print(" (ahead {d})", .{self.ahead});
+        } else if (self.behind > 0) {
+            try writer.print(" (behind {d})", .{self.behind});
+        }
+    }
+};
+
+/// Stops a status load from another thread: raises a flag the native index
+/// walk polls and SIGKILLs the git child, if one is running.
+pub const Cancel = struct {
+    mutex: std.Thread.Mutex = .{},
+    pid: ?std.posix.pid_t = null, // Running git child, guarded by mutex
+    cancelled: std.atomic.Value(bool) = .init(false),
+
+    pub fn fire(self: *Cancel) void {
+        self.cancelled.store(true, .monotonic);
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        if (self.pid) |pid| std.posix.kill(pid, std.posix.SIG.KILL) catch {};
+    }
+
+    pub fn isCancelled(self: *const Cancel) bool {
+        return self.cancelled.load(.monotonic);
+    }
+
+    /// Track a freshly spawned child; kills it at once if fire() came first.
+    fn attach(self: *Cancel, pid: std.posix.pid_t) void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        self.pid = pid;
+        if (self.isCancelled()) std.posix.kill(pid, std.posix.SIG.KILL) catch {};
+    }
+
+    fn detach(self: *Cancel) void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        self.pid = null;
+    }
+};
+
+/// `git status` running on its own thread while the directory is listed.
+/// The context is built in the thread's own arena: the caller's allocator
+/// is usually an ArenaAllocator, which is not thread-safe.
+pub const Pending = struct {
+    arena: std.heap.ArenaAllocator,
+    dir_path: []const u8,
+    options: types.GitOptions,
+    thread: ?std.Thread = null,
+    result: ?GitContext = null,
+    cancel: Cancel = .{},
+    done: std.Thread.ResetEvent = .{}, // Set when run() returns
+    // --git-timeout, counted from start()
+    deadline_ns: ?i128 = null,
+    timed_out: bool = false,
+    // Span of the git phase (std.time.nanoTimestamp) for --timing
+    started_ns: i128 = 0,
+    finished_ns: i128 = 0,
+
+    /// Start loading status for dir_path. `self` must not move until deinit.
+    /// If no thread can be spawned, wait() loads it synchronously instead
+    /// (with no deadline: nothing is left to enforce it).
+    pub fn start(self: *Pending, dir_path: []const u8, options: types.GitOptions) void {
+        self.* = .{ .arena = .init(std.heap.page_allocator), .dir_path = dir_path, .options = options };
+        if (options.timeout_ns) |timeout| self.deadline_ns = std.time.nanoTimestamp() + timeout;
+        self.thread = std.Thread.spawn(.{}, run, .{self}) catch null;
+    }
+
+    fn run(self: *Pending) void {
+        self.started_ns = std.time.nanoTimestamp();
+        self.result = GitContext.init(self.arena.allocator(), self.dir_path, self.options, &self.cancel) catch null;
+        self.finished_ns = std.time.nanoTimestamp();
+        self.done.set();
+    }
+
+    /// Block until git is done or the deadline passes, whichever is first.
+    /// Null if not a git repository or git failed. Past the deadline git is
+    /// killed, timed_out is set and the context reports every entry unknown.
+    pub fn wait(self: *Pending) ?*const GitContext {
+        if (self.thread) |thread| {
+            if (self.deadline_ns) |deadline| {
+                const remaining = @max(deadline - std.time.nanoTimestamp(), 0);
+                self.done.timedWait(@intCast(remaining)) catch self.cancel.fire();
             }
+            thread.join(); // Prompt once cancelled: git is dead, the walk polls
+            self.thread = null;
+            if (self.result == null and self.cancel.isCancelled()) {
+                self.timed_out = true;
+                self.result = .{
+                    .allocator = self.arena.allocator(),
+                    .statuses = .init(self.arena.allocator()),
+                    .rel_prefix = &.{},
+                    .degraded = true,
+                };
+            }
+        } else if (self.finished_ns == 0) {
+            self.run();
         }
+        return if (self.result) |*ctx| ctx else null;
+    }
 
-        return best_status;
+    pub fn deinit(self: *Pending) void {
+        _ = self.wait();
+        self.arena.deinit(); // Owns the context's keys and map
     }
 };
 
@@ -266,18 +581,13 @@ test "GitContext parseTrackedFile - valid format" {
         .statuses = std.StringHashMap(types.FileInfo.GitStatus).init(allocator),
         .rel_prefix = &.{},
     };
-    defer {
-        var it = ctx.statuses.keyIterator();
-        while (it.next()) |key| {
-            allocator.free(key.*);
-        }
-        ctx.statuses.deinit();
-    }
+    defer ctx.deinit();
 
     // Format: "1 XY sub <mH> <mI> <mW> <hH> <hI> <path>"
     try ctx.parseTrackedFile("1 M. N... 100644 100644 100644 abc123 def456 src/main.zig");
 
-    const status = ctx.statuses.get("src/main.zig");
+    // Keys are stripped to the listed directory's children
+    const status = ctx.dir_statuses.get("src");
     try std.testing.expect(status != null);
     try std.testing.expectEqual(types.FileInfo.GitStatus.staged_modified, status.?);
 }
@@ -289,17 +599,11 @@ test "GitContext parseTrackedFile - unstaged modification" {
         .statuses = std.StringHashMap(types.FileInfo.GitStatus).init(allocator),
         .rel_prefix = &.{},
     };
-    defer {
-        var it = ctx.statuses.keyIterator();
-        while (it.next()) |key| {
-            allocator.free(key.*);
-        }
-        ctx.statuses.deinit();
-    }
+    defer ctx.deinit();
 
     try ctx.parseTrackedFile("1 .M N... 100644 100644 100644 abc123 def456 test/file.txt");
 
-    const status = ctx.statuses.get("test/file.txt");
+    const status = ctx.dir_statuses.get("test");
     try std.testing.expect(status != null);
     try std.testing.expectEqual(types.FileInfo.GitStatus.unstaged_modified, status.?);
 }
@@ -311,16 +615,9 @@ test "GitContext parseTrackedFile - path with spaces" {
         .statuses = std.StringHashMap(types.FileInfo.GitStatus).init(allocator),
         .rel_prefix = &.{},
     };
-    defer {
-        var it = ctx.statuses.keyIterator();
-        while (it.next()) |key| {
-            allocator.free(key.*);
-        }
-        ctx.statuses.deinit();
-    }
+    defer ctx.deinit();
 
-    // Note: Git escapes spaces in paths, but we'll handle the simple case
-    // In real git output, this would be escaped
+    // With -z git leaves spaces (and any other byte) in paths unquoted
     try ctx.parseTrackedFile("1 A. N... 100644 100644 100644 abc123 def456 my file.txt");
 
     const status = ctx.statuses.get("my file.txt");
@@ -335,13 +632,7 @@ test "GitContext parseUntrackedFile - valid format" {
         .statuses = std.StringHashMap(types.FileInfo.GitStatus).init(allocator),
         .rel_prefix = &.{},
     };
-    defer {
-        var it = ctx.statuses.keyIterator();
-        while (it.next()) |key| {
-            allocator.free(key.*);
-        }
-        ctx.statuses.deinit();
-    }
+    defer ctx.deinit();
 
     try ctx.parseUntrackedFile("? untracked.txt");
 
@@ -357,13 +648,7 @@ test "GitContext parseUntrackedFile - directory" {
         .statuses = std.StringHashMap(types.FileInfo.GitStatus).init(allocator),
         .rel_prefix = &.{},
     };
-    defer {
-        var it = ctx.statuses.keyIterator();
-        while (it.next()) |key| {
-            allocator.free(key.*);
-        }
-        ctx.statuses.deinit();
-    }
+    defer ctx.deinit();
 
     try ctx.parseUntrackedFile("? build/");
 
@@ -379,16 +664,9 @@ test "GitContext getStatus - exact match" {
         .statuses = std.StringHashMap(types.FileInfo.GitStatus).init(allocator),
         .rel_prefix = &.{},
     };
-    defer {
-        var it = ctx.statuses.keyIterator();
-        while (it.next()) |key| {
-            allocator.free(key.*);
-        }
-        ctx.statuses.deinit();
-    }
+    defer ctx.deinit();
 
-    const owned_path = try allocator.dupe(u8, "test.txt");
-    try ctx.statuses.put(owned_path, .unstaged_modified);
+    try ctx.record("test.txt", .unstaged_modified);
 
     const status = ctx.getStatus("test.txt", false);
     try std.testing.expectEqual(types.FileInfo.GitStatus.unstaged_modified, status);
@@ -414,16 +692,9 @@ test "GitContext getStatus - directory with trailing slash" {
         .statuses = std.StringHashMap(types.FileInfo.GitStatus).init(allocator),
         .rel_prefix = &.{},
     };
-    defer {
-        var it = ctx.statuses.keyIterator();
-        while (it.next()) |key| {
-            allocator.free(key.*);
-        }
-        ctx.statuses.deinit();
-    }
+    defer ctx.deinit();
 
-    const owned_path = try allocator.dupe(u8, "src/");
-    try ctx.statuses.put(owned_path, .untracked);
+    try ctx.record("src/", .untracked);
 
     // Query without trailing slash
     const status = ctx.getStatus("src", true);
@@ -437,16 +708,9 @@ test "GitContext getStatus - directory exact match without slash" {
         .statuses = std.StringHashMap(types.FileInfo.GitStatus).init(allocator),
         .rel_prefix = &.{},
     };
-    defer {
-        var it = ctx.statuses.keyIterator();
-        while (it.next()) |key| {
-            allocator.free(key.*);
-        }
-        ctx.statuses.deinit();
-    }
+    defer ctx.deinit();
 
-    const owned_path = try allocator.dupe(u8, "build");
-    try ctx.statuses.put(owned_path, .untracked);
+    try ctx.record("build", .untracked);
 
     const status = ctx.getStatus("build", true);
     try std.testing.expectEqual(types.FileInfo.GitStatus.untracked, status);
@@ -459,13 +723,7 @@ test "GitContext parseTrackedFile - staged added" {
         .statuses = std.StringHashMap(types.FileInfo.GitStatus).init(allocator),
         .rel_prefix = &.{},
     };
-    defer {
-        var it = ctx.statuses.keyIterator();
-        while (it.next()) |key| {
-            allocator.free(key.*);
-        }
-        ctx.statuses.deinit();
-    }
+    defer ctx.deinit();
 
     try ctx.parseTrackedFile("1 A. N... 000000 100644 100644 000000 abc123 new_file.zig");
 
@@ -481,13 +739,7 @@ test "GitContext parseTrackedFile - staged deleted" {
         .statuses = std.StringHashMap(types.FileInfo.GitStatus).init(allocator),
         .rel_prefix = &.{},
     };
-    defer {
-        var it = ctx.statuses.keyIterator();
-        while (it.next()) |key| {
-            allocator.free(key.*);
-        }
-        ctx.statuses.deinit();
-    }
+    defer ctx.deinit();
 
     try ctx.parseTrackedFile("1 D. N... 100644 000000 000000 abc123 000000 deleted.zig");
 
@@ -510,11 +762,9 @@ test "GitContext init and deinit - memory safety" {
     };
 
     // Manually add some entries to test cleanup
-    const path1 = try allocator.dupe(u8, "test1.zig");
-    const path2 = try allocator.dupe(u8, "test2.zig");
-
-    try ctx.statuses.put(path1, .unstaged_modified);
-    try ctx.statuses.put(path2, .staged_added);
+    try ctx.record("test1.zig", .unstaged_modified);
+    try ctx.record("test2.zig", .staged_added);
+    try ctx.record("src/test3.zig", .staged_added);
 
     // deinit should free all keys
     ctx.deinit();
@@ -529,19 +779,246 @@ test "GitContext getStatus - files inherit untracked from current directory" {
         .statuses = std.StringHashMap(types.FileInfo.GitStatus).init(allocator),
         .rel_prefix = &.{},
     };
-    defer {
-        var it = ctx.statuses.keyIterator();
-        while (it.next()) |key| {
-            allocator.free(key.*);
-        }
-        ctx.statuses.deinit();
-    }
+    defer ctx.deinit();
 
     // Simulate git status from an untracked directory: "? ./"
-    const owned_path = try allocator.dupe(u8, "./");
-    try ctx.statuses.put(owned_path, .untracked);
+    try ctx.record("./", .untracked);
 
     // Any file lookup should return untracked (not clean)
     const status = ctx.getStatus("some_file.txt", false);
     try std.testing.expectEqual(types.FileInfo.GitStatus.untracked, status);
 }
+
+test "GitContext annotate - joins statuses onto a listing" {
+    const allocator = std.testing.allocator;
+    var ctx = GitContext{
+        .allocator = allocator,
+        .statuses = std.StringHashMap(types.FileInfo.GitStatus).init(allocator),
+        .rel_prefix = &.{},
+    };
+    defer ctx.deinit();
+    try ctx.record("a.txt", .unstaged_modified);
+    try ctx.record("src/main.zig", .staged_added);
+
+    const listing = try types.Listing.fromSpecs(allocator, &.{
+        .{ .name = ".", .kind = .directory },
+        .{ .name = "a.txt" },
+        .{ .name = "b.txt" },
+        .{ .name = "src", .kind = .directory },
+    });
+    defer listing.deinit(allocator);
+
+    ctx.annotate(listing);
+    try std.testing.expectEqual(types.FileInfo.GitStatus.clean, listing.files[0].git_status);
+    try std.testing.expectEqual(types.FileInfo.GitStatus.unstaged_modified, listing.files[1].git_status);
+    try std.testing.expectEqual(types.FileInfo.GitStatus.clean, listing.files[2].git_status);
+    try std.testing.expectEqual(types.FileInfo.GitStatus.staged_added, listing.files[3].git_status);
+}
+
+test "Pending - wait is idempotent outside a repository" {
+    var tmp = std.testing.tmpDir(.{});
+    defer tmp.cleanup();
+    const path = try tmp.dir.realpathAlloc(std.testing.allocator, ".");
+    defer std.testing.allocator.free(path);
+
+    var pending: Pending = undefined;
+    pending.start(path, .{});
+    defer pending.deinit();
+
+    const first = pending.wait();
+    try std.testing.expectEqual(first, pending.wait());
+    try std.testing.expect(pending.finished_ns >= pending.started_ns);
+}
+
+test "GitContext parseStream - branch headers" {
+    const allocator = std.testing.allocator;
+    var ctx = GitContext{
+        .allocator = allocator,
+        .statuses = std.StringHashMap(types.FileInfo.GitStatus).init(allocator),
+        .rel_prefix = &.{},
+    };
+    defer ctx.deinit();
+
+    const output = "# branch.oid 0123abcd\x00# branch.head feature/x y\x00# branch.upstream origin/feature/x y\x00" ++
+        "# branch.ab +2 -1\x00# stash 3\x00? new.txt\x00";
+    var reader = std.Io.Reader.fixed(output);
+    try ctx.parseStream(&reader);
+
+    try std.testing.expectEqualStrings("feature/x y", ctx.branch.head.?);
+    try std.testing.expectEqualStrings("origin/feature/x y", ctx.branch.upstream.?);
+    try std.testing.expectEqual(@as(u32, 2), ctx.branch.ahead);
+    try std.testing.expectEqual(@as(u32, 1), ctx.branch.behind);
+    try std.testing.expectEqual(types.FileInfo.GitStatus.untracked, ctx.getStatus("new.txt", false));
+
+    var bad = std.Io.Reader.fixed("# branch.ab 2 1\x00");
+    try std.testing.expectError(error.InvalidFormat, ctx.parseStream(&bad));
+}
+
+test "Branch.write - head, upstream and divergence" {
+    var buf: [128]u8 = undefined;
+    const cases = [_]struct { branch: Branch, expected: []const u8 }{
+        .{ .branch = .{}, .expected = "" },
+        .{ .branch = .{ .head = "main" }, .expected = "main" },
+        .{ .branch = .{ .head = "main", .upstream = "origin/main" }, .expected = "main → origin/main" },
+        .{ .branch = .{ .head = "main", .upstream = "origin/main", .ahead = 2 }, .expected = "main → origin/main (ahead 2)" },
+        .{ .branch = .{ .head = "main", .upstream = "origin/main", .ahead = 2, .behind = 1 }, .expected = "main → origin/main (ahead 2, behind 1)" },
+    };
+    for (cases) |case| {
+        var writer = std.Io.Writer.fixed(&buf);
+        try case.branch.write(&writer);
+        try std.testing.expectEqualStrings(case.expected, writer.buffered());
+    }
+}
+
+test "GitContext getStatus - degraded context reports unknown" {
+    const allocator = std.testing.allocator;
+    var ctx = GitContext{
+        .allocator = allocator,
+        .statuses = std.StringHashMap(types.FileInfo.GitStatus).init(allocator),
+        .rel_prefix = &.{},
+        .degraded = true,
+    };
+    defer ctx.deinit();
+
+    try std.testing.expectEqual(types.FileInfo.GitStatus.unknown, ctx.getStatus("a.txt", false));
+    try std.testing.expectEqual(types.FileInfo.GitStatus.unknown, ctx.getStatus("src", true));
+}
+
+test "Cancel - fire kills an attached child, attach after fire kills at once" {
+    var cancel = Cancel{};
+    var child = std.process.Child.init(&.{ "sleep", "10" }, std.testing.allocator);
+    child.spawn() catch return error.SkipZigTest;
+    cancel.attach(child.id);
+    cancel.fire();
+    cancel.detach();
+    try std.testing.expect(cancel.isCancelled());
+    try std.testing.expectEqual(std.process.Child.Term{ .Signal = std.posix.SIG.KILL }, try child.wait());
+
+    var late = std.process.Child.init(&.{ "sleep", "10" }, std.testing.allocator);
+    late.spawn() catch return error.SkipZigTest;
+    cancel.attach(late.id);
+    cancel.detach();
+    try std.testing.expectEqual(std.process.Child.Term{ .Signal = std.posix.SIG.KILL }, try late.wait());
+}
+
+test "GitContext parseStream - NUL records, renames and raw paths" {
+    const allocator = std.testing.allocator;
+    var ctx = GitContext{
+        .allocator = allocator,
+        .statuses = std.StringHashMap(types.FileInfo.GitStatus).init(allocator),
+        .rel_prefix = &.{},
+    };
+    defer ctx.deinit();
+
+    const output = "# branch.head main\x00" ++
+        "1 .M N... 100644 100644 100644 abc123 def456 a \"quoted\" name.txt\x00" ++
+        "2 R. N... 100644 100644 100644 abc123 def456 R100 new name.zig\x00old name.zig\x00" ++
+        "? caf\xc3\xa9 \x00" ++
+        "? build/\x00";
+    var reader: std.Io.Reader = .fixed(output);
+    try ctx.parseStream(&reader);
+
+    try std.testing.expectEqual(@as(u32, 4), ctx.statuses.count());
+    try std.testing.expectEqual(types.FileInfo.GitStatus.unstaged_modified, ctx.statuses.get("a \"quoted\" name.txt").?);
+    try std.testing.expectEqual(types.FileInfo.GitStatus.staged_renamed, ctx.statuses.get("new name.zig").?);
+    try std.testing.expect(ctx.statuses.get("old name.zig") == null);
+    try std.testing.expectEqual(types.FileInfo.GitStatus.untracked, ctx.statuses.get("caf\xc3\xa9 ").?);
+    try std.testing.expectEqual(types.FileInfo.GitStatus.untracked, ctx.statuses.get("build/").?);
+}
+
+test "GitContext parseStream - output larger than the read buffer" {
+    const allocator = std.testing.allocator;
+    var ctx = GitContext{
+        .allocator = allocator,
+        .statuses = std.StringHashMap(types.FileInfo.GitStatus).init(allocator),
+        .rel_prefix = &.{},
+    };
+    defer ctx.deinit();
+
+    // Records arrive through a 64-byte window, far smaller than the output
+    var output: std.ArrayList(u8) = .empty;
+    defer output.deinit(allocator);
+    for (0..500) |i| try output.print(allocator, "? file_{d}.out\x00", .{i});
+    var source: std.Io.Reader = .fixed(output.items);
+    var window: [64]u8 = undefined;
+    var limited = source.limited(.unlimited, &window);
+    try ctx.parseStream(&limited.interface);
+
+    try std.testing.expectEqual(@as(u32, 500), ctx.statuses.count());
+    try std.testing.expectEqual(types.FileInfo.GitStatus.untracked, ctx.statuses.get("file_499.out").?);
+}
+
+test "GitContext record - directory aggregate keeps the most urgent status" {
+    const allocator = std.testing.allocator;
+    var ctx = GitContext{
+        .allocator = allocator,
+        .statuses = std.StringHashMap(types.FileInfo.GitStatus).init(allocator),
+        .rel_prefix = &.{},
+    };
+    defer ctx.deinit();
+
+    try ctx.record("src/gen/out.txt", .untracked);
+    try ctx.record("src/lib/a.zig", .staged_modified);
+    try ctx.record("src/b.zig", .unstaged_modified);
+    try ctx.record("src/c.zig", .staged_added);
+    try ctx.record("docs/new/", .untracked);
+    try ctx.record("build/", .untracked);
+
+    try std.testing.expectEqual(types.FileInfo.GitStatus.unstaged_modified, ctx.getStatus("src", true));
+    try std.testing.expectEqual(types.FileInfo.GitStatus.untracked, ctx.getStatus("docs", true));
+    try std.testing.expectEqual(types.FileInfo.GitStatus.untracked, ctx.getStatus("build", true));
+    try std.testing.expectEqual(types.FileInfo.GitStatus.clean, ctx.getStatus("srcx", true));
+    try std.testing.expect(ctx.dir_statuses.get("build") == null);
+    // Deep paths leave no key of their own
+    try std.testing.expectEqual(@as(u32, 1), ctx.statuses.count());
+    try std.testing.expect(ctx.statuses.get("src/b.zig") == null);
+}
+
+test "statusArgv - read-only base command plus selected tunings" {
+    var buf: [max_status_args][]const u8 = undefined;
+    const plain = statusArgv(&buf, .{});
+    try std.testing.expectEqual(@as(usize, 7), plain.len);
+    try std.testing.expectEqualStrings("--no-optional-locks", plain[1]);
+    try std.testing.expectEqualStrings(".", plain[6]);
+
+    const tuned = statusArgv(&buf, .{ .branch = true, .renames = false, .untracked = .no, .submodules = .all });
+    try std.testing.expectEqual(@as(usize, max_status_args), tuned.len);
+    try std.testing.expectEqualStrings("--branch", tuned[5]);
+    try std.testing.expectEqualStrings("--no-renames", tuned[6]);
+    try std.testing.expectEqualStrings("--untracked-files=no", tuned[7]);
+    try std.testing.expectEqualStrings("--ignore-submodules=all", tuned[8]);
+    try std.testing.expectEqualStrings("--", tuned[9]);
+}
+
+test "childEnv - locks off, prompts off, nothing else inherited" {
+    var env = try childEnv(std.testing.allocator);
+    defer env.deinit();
+    try std.testing.expectEqualStrings("0", env.get("GIT_OPTIONAL_LOCKS").?);
+    try std.testing.expectEqualStrings("0", env.get("GIT_TERMINAL_PROMPT").?);
+    try std.testing.expect(env.get("GIT_TRACE") == null);
+    try std.testing.expect(env.count() <= passthrough_env.len + 3);
+}
+
+test "GitContext record - strips the listed directory's worktree prefix" {
+    const allocator = std.testing.allocator;
+    var ctx = GitContext{
+        .allocator = allocator,
+        .statuses = std.StringHashMap(types.FileInfo.GitStatus).init(allocator),
+        .rel_prefix = "a",
+    };
+    defer ctx.deinit();
+
+    try ctx.record("a/b/f", .unstaged_modified);
+    try ctx.record("a/g2", .staged_renamed);
+    try ctx.record("ab/other", .untracked);
+    try ctx.record("top.txt", .untracked);
+
+    try std.testing.expectEqual(types.FileInfo.GitStatus.unstaged_modified, ctx.getStatus("b", true));
+    try std.testing.expectEqual(types.FileInfo.GitStatus.staged_renamed, ctx.getStatus("g2", false));
+    try std.testing.expectEqual(@as(u32, 1), ctx.statuses.count());
+
+    // Listing a/new while git reports "? a/new/": everything inside is untracked
+    ctx.rel_prefix = "a/new";
+    try ctx.record("a/new/", .untracked);
+    try std.testing.expectEqual(types.FileInfo.GitStatus.untracked, ctx.getStatus("h", false));
+}
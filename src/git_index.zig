@@ -0,0 +1,874 @@
+//! Native reader for .git/index (versions 2-4).
+//!
+//! Used to prove a listed directory clean without forking git: every tracked
+//! entry under it must still match its cached stat data, nothing untracked may
+//! sit next to them, and the index must equal HEAD's tree (no staged changes).
+//! Anything this module can't decide with certainty - racy timestamps, stat
+//! mismatches, untracked or ignored names, submodules, split or sparse
+//! indexes, packed deltas, subtrees too big to walk cheaply - makes
+//! provesClean return false and the caller runs `git status` as before.
+//!
+//! Also finds the repository for a directory the way git does (discover),
+//! so git is never spawned where it would only fail.
+
+const std = @import("std");
+
+const oid_len = 20; // SHA-1; SHA-256 repositories fall back to git
+const max_path = std.fs.max_path_bytes;
+// Names the walk may lstat before leaving the subtree to git. A failed proof
+// is paid again by git's own scan, so big subtrees go straight to git.
+// Untested guess; bench/git_status.sh is the way to tune it.
+const max_walk_names = 20_000;
+
+/// True when everything under the discovered worktree's listed directory is
+/// known clean from .git/index alone. False means "ask git", never "dirty".
+/// Setting `stop` abandons the walk.
+pub fn provesClean(allocator: std.mem.Allocator, worktree: Worktree, stop: ?*const std.atomic.Value(bool)) bool {
+    var arena = std.heap.ArenaAllocator.init(allocator);
+    defer arena.deinit();
+    return checkClean(arena.allocator(), worktree, stop) catch false;
+}
+
+fn checkClean(allocator: std.mem.Allocator, worktree: Worktree, stop: ?*const std.atomic.Value(bool)) !bool {
+    // Environment overrides change what git would read; leave those to git
+    for ([_][]const u8{ "GIT_DIR", "GIT_WORK_TREE", "GIT_INDEX_FILE", "GIT_OBJECT_DIRECTORY" }) |name| {
+        if (std.posix.getenv(name) != null) return false;
+    }
+    // Gitfiles (worktrees, submodules) point elsewhere; git follows those
+    if (!worktree.git_is_dir) return false;
+    const rel = worktree.prefix();
+
+    var root = try std.fs.openDirAbsolute(worktree.root(), .{});
+    defer root.close();
+    var git_dir = try root.openDir(".git", .{ .iterate = true });
+    defer git_dir.close();
+
+    if (try usesSha256(allocator, git_dir)) return false;
+
+    const index_file = try git_dir.openFile("index", .{});
+    defer index_file.close();
+    const index_stat = try std.posix.fstat(index_file.handle);
+    const data = try mapFile(index_file);
+    defer std.posix.munmap(data);
+
+    const index = try Index.parse(data);
+    var tracked = try Tracked.collect(allocator, index, rel, @intCast(index_stat.mtime().sec));
+    // A clean walk visits every tracked file, so this one would run out
+    if (tracked.files.count() > tracked.budget) return false;
+
+    // Staged changes: the index must hash to HEAD's tree
+    const index_tree = index.cacheTreeRoot(tracked.extensions_offset) orelse return false;
+    const head_tree = try headTree(allocator, git_dir);
+    if (!std.mem.eql(u8, &index_tree, &head_tree)) return false;
+
+    // Unstaged and untracked changes: walk the listed subtree
+    var dir = try std.fs.openDirAbsolute(worktree.path, .{ .iterate = true });
+    defer dir.close();
+    var path_buf: [max_path]u8 = undefined;
+    tracked.stop = stop;
+    try tracked.walk(dir, &path_buf, 0, rel.len == 0);
+    return tracked.seen == tracked.files.count();
+}
+
+// ───────────────────────────────────────────────────────────
+// Repository discovery
+// ───────────────────────────────────────────────────────────
+
+/// Where dir_path sits in its working tree.
+pub const Worktree = struct {
+    path: []const u8, // Absolute dir_path
+    root_len: usize, // path[0..root_len] is the worktree root
+    // `.git` is a directory at the root. False for gitfiles (worktrees,
+    // submodules) and for repositories chosen by GIT_DIR.
+    git_is_dir: bool,
+
+    pub fn root(self: Worktree) []const u8 {
+        return self.path[0..self.root_len];
+    }
+
+    /// dir_path relative to the worktree root, "" at the root
+    pub fn prefix(self: Worktree) []const u8 {
+        if (self.root_len == self.path.len) return "";
+        return self.path[self.root_len + @intFromBool(self.root_len > 1) ..];
+    }
+};
+
+/// Find the working tree dir_path belongs to the way git's own setup does,
+/// so git is only spawned where it would find a repository. Null means
+/// `git status` would fail here (no repository, or inside a `.git`).
+///
+/// GIT_DIR names the repository outright; the worktree is then
+/// GIT_WORK_TREE, or dir_path itself (git's cwd). Otherwise walk up from
+/// dir_path, honouring GIT_CEILING_DIRECTORIES and not crossing a
+/// filesystem boundary unless GIT_DISCOVERY_ACROSS_FILESYSTEM is set;
+/// GIT_WORK_TREE then only moves the root.
+pub fn discover(buf: *[max_path]u8, dir_path: []const u8) !?Worktree {
+    const abs = try std.fs.cwd().realpath(dir_path, buf);
+    const work_tree = std.posix.getenv("GIT_WORK_TREE");
+
+    var worktree: Worktree = undefined;
+    if (std.posix.getenv("GIT_DIR") != null) {
+        worktree = .{ .path = abs, .root_len = abs.len, .git_is_dir = false };
+    } else {
+        const ceilings = std.posix.getenv("GIT_CEILING_DIRECTORIES") orelse "";
+        const across = envBool(std.posix.getenv("GIT_DISCOVERY_ACROSS_FILESYSTEM"));
+        worktree = (try walkUp(abs, ceilings, across)) orelse return null;
+    }
+
+    if (work_tree) |path| {
+        var root_buf: [max_path]u8 = undefined;
+        const root = try std.fs.cwd().realpath(path, &root_buf);
+        if (!isAncestorOrSelf(root, abs)) return error.NotInWorkTree;
+        worktree.root_len = root.len;
+    }
+    return worktree;
+}
+
+/// Walk up from `abs` to the nearest directory holding a `.git` directory
+/// (with a HEAD) or gitfile. Never moves up into the longest of `ceilings`
+/// (colon-separated absolute paths) above `abs`, nor onto another device
+/// unless `across_filesystems`.
+fn walkUp(abs: []const u8, ceilings: []const u8, across_filesystems: bool) !?Worktree {
+    const ceiling_len = ceilingLength(abs, ceilings);
+    const dev = (try std.posix.fstatat(std.fs.cwd().fd, abs, 0)).dev;
+
+    var root: []const u8 = abs;
+    while (true) {
+        if (try gitEntry(root)) |git_is_dir| {
+            const worktree = Worktree{ .path = abs, .root_len = root.len, .git_is_dir = git_is_dir };
+            // Inside the repository's own .git: git status refuses to run
+            const prefix = worktree.prefix();
+            if (std.mem.eql(u8, prefix, ".git") or std.mem.startsWith(u8, prefix, ".git/")) return null;
+            return worktree;
+        }
+        const parent = std.fs.path.dirname(root) orelse return null;
+        if (parent.len <= ceiling_len) return null;
+        if (!across_filesystems and (try std.posix.fstatat(std.fs.cwd().fd, parent, 0)).dev != dev) return null;
+        root = parent;
+    }
+}
+
+/// Whether `<dir>/.git` marks a repository: true for a directory with a
+/// HEAD, false for a "gitdir: " file, null when there is neither.
+fn gitEntry(dir: []const u8) !?bool {
+    var probe_buf: [max_path]u8 = undefined;
+    const probe = try std.fmt.bufPrint(&probe_buf, "{s}/.git", .{if (dir.len == 1) "" else dir});
+    const st = std.fs.cwd().statFile(probe) catch |err| switch (err) {
+        error.FileNotFound, error.NotDir => return null,
+        else => return err,
+    };
+    switch (st.kind) {
+        .directory => {
+            var git_dir = try std.fs.openDirAbsolute(probe, .{});
+            defer git_dir.close();
+            git_dir.access("HEAD", .{}) catch return null;
+            return true;
+        },
+        .file => {
+            var head_buf: [8]u8 = undefined;
+            const head = try std.fs.cwd().readFile(probe, &head_buf);
+            return if (std.mem.eql(u8, head, "gitdir: ")) false else null;
+        },
+        else => return null,
+    }
+}
+
+/// Length of the longest ceiling that is a proper ancestor of `abs`, 0 if
+/// none is. Relative entries are ignored, as git does.
+fn ceilingLength(abs: []const u8, ceilings: []const u8) usize {
+    var longest: usize = 0;
+    var it = std.mem.splitScalar(u8, ceilings, ':');
+    while (it.next()) |entry| {
+        if (entry.len == 0 or entry[0] != '/') continue;
+        var buf: [max_path]u8 = undefined;
+        const resolved = std.fs.cwd().realpath(entry, &buf) catch entry;
+        const ceiling = if (resolved.len > 1) std.mem.trimRight(u8, resolved, "/") else resolved;
+        if (ceiling.len < abs.len and isAncestorOrSelf(ceiling, abs)) longest = @max(longest, ceiling.len);
+    }
+    return longest;
+}
+
+fn isAncestorOrSelf(ancestor: []const u8, path: []const u8) bool {
+    if (!std.mem.startsWith(u8, path, ancestor)) return false;
+    return path.len == ancestor.len or std.mem.eql(u8, ancestor, "/") or path[ancestor.len] == '/';
+}
+
+/// Git's boolean environment values
+fn envBool(value: ?[]const u8) bool {
+    const v = value orelse return false;
+    for ([_][]const u8{ "1", "true", "yes", "on" }) |yes| {
+        if (std.ascii.eqlIgnoreCase(v, yes)) return true;
+    }
+    return false;
+}
+
+fn usesSha256(allocator: std.mem.Allocator, git_dir: std.fs.Dir) !bool {
+    const config = git_dir.readFileAlloc(allocator, "config", 1024 * 1024) catch |err| switch (err) {
+        error.FileNotFound => return false,
+        else => return err,
+    };
+    return std.ascii.indexOfIgnoreCase(config, "objectformat") != null;
+}
+
+fn mapFile(file: std.fs.File) ![]align(std.heap.page_size_min) const u8 {
+    const size = (try file.stat()).size;
+    if (size == 0) return error.InvalidIndex;
+    return std.posix.mmap(null, size, std.posix.PROT.READ, .{ .TYPE = .PRIVATE }, file.handle, 0);
+}
+
+// ───────────────────────────────────────────────────────────
+// Index format
+// ───────────────────────────────────────────────────────────
+
+pub const Entry = struct {
+    ctime_s: u32,
+    ctime_ns: u32,
+    mtime_s: u32,
+    mtime_ns: u32,
+    ino: u32,
+    mode: u32,
+    uid: u32,
+    gid: u32,
+    size: u32,
+    flags: u16,
+    ext_flags: u16,
+    path: []const u8,
+
+    const flag_extended: u16 = 0x4000;
+    const ext_skip_worktree: u16 = 0x4000;
+    const ext_intent_to_add: u16 = 0x2000;
+
+    fn stage(self: Entry) u2 {
+        return @truncate(self.flags >> 12);
+    }
+};
+
+pub const Index = struct {
+    data: []const u8,
+    version: u32,
+    count: u32,
+
+    const header_len = 12;
+    const fixed_len = 62; // Stat fields, object id and flags
+
+    pub fn parse(data: []const u8) !Index {
+        if (data.len < header_len + oid_len or !std.mem.eql(u8, data[0..4], "DIRC")) return error.InvalidIndex;
+        const version = readU32(data, 4);
+        if (version < 2 or version > 4) return error.InvalidIndex;
+        return .{ .data = data, .version = version, .count = readU32(data, 8) };
+    }
+
+    pub fn iterator(self: Index, name_buf: *[max_path]u8) Iterator {
+        return .{ .index = self, .pos = header_len, .name_buf = name_buf };
+    }
+
+    /// Root object id from the cache-tree ("TREE") extension, or null when the
+    /// extension is missing or the root was invalidated by `git add`.
+    /// `offset` is where the entries end (Iterator.pos after the last entry).
+    pub fn cacheTreeRoot(self: Index, offset: usize) ?[oid_len]u8 {
+        var pos = offset;
+        const end = self.data.len - oid_len; // Trailing checksum
+        while (pos + 8 <= end) {
+            const sig = self.data[pos..][0..4];
+            const len = readU32(self.data, pos + 4);
+            const body_start = pos + 8;
+            if (body_start + len > end) return null;
+            if (std.mem.eql(u8, sig, "TREE")) return parseTreeRoot(self.data[body_start..][0..len]);
+            pos = body_start + len;
+        }
+        return null;
+    }
+
+    /// True if the index carries an extension that changes what its entries
+    /// mean (split index, sparse directories).
+    pub fn hasUnsupportedExtension(self: Index, offset: usize) bool {
+        var pos = offset;
+        const end = self.data.len - oid_len;
+        while (pos + 8 <= end) {
+            const sig = self.data[pos..][0..4];
+            if (std.mem.eql(u8, sig, "link") or std.mem.eql(u8, sig, "sdir")) return true;
+            pos += 8 + readU32(self.data, pos + 4);
+        }
+        return false;
+    }
+
+    pub const Iterator = struct {
+        index: Index,
+        pos: usize,
+        read: u32 = 0,
+        name_buf: *[max_path]u8,
+        prev_len: usize = 0, // v4: length of the previous name in name_buf
+
+        /// Next entry. For v4 the path lives in name_buf and is only valid
+        /// until the next call; for v2/v3 it points into the index data.
+        pub fn next(self: *Iterator) !?Entry {
+            if (self.read == self.index.count) return null;
+            const data = self.index.data;
+            const start = self.pos;
+            if (start + fixed_len > data.len - oid_len) return error.InvalidIndex;
+
+            var entry = Entry{
+                .ctime_s = readU32(data, start),
+                .ctime_ns = readU32(data, start + 4),
+                .mtime_s = readU32(data, start + 8),
+                .mtime_ns = readU32(data, start + 12),
+                .ino = readU32(data, start + 20),
+                .mode = readU32(data, start + 24),
+                .uid = readU32(data, start + 28),
+                .gid = readU32(data, start + 32),
+                .size = readU32(data, start + 36),
+                .flags = readU16(data, start + 60),
+                .ext_flags = 0,
+                .path = &.{},
+            };
+            var pos = start + fixed_len;
+            if (entry.flags & Entry.flag_extended != 0) {
+                if (self.index.version < 3) return error.InvalidIndex;
+                entry.ext_flags = readU16(data, pos);
+                pos += 2;
+            }
+
+            if (self.index.version == 4) {
+                // Prefix compression: drop N bytes from the previous name, append the suffix
+                const strip = try readVarint(data, &pos);
+                if (strip > self.prev_len) return error.InvalidIndex;
+                const suffix_end = std.mem.indexOfScalarPos(u8, data, pos, 0) orelse return error.InvalidIndex;
+                const keep = self.prev_len - strip;
+                const suffix = data[pos..suffix_end];
+                if (keep + suffix.len > max_path) return error.InvalidIndex;
+                @memcpy(self.name_buf[keep..][0..suffix.len], suffix);
+                self.prev_len = keep + suffix.len;
+                entry.path = self.name_buf[0..self.prev_len];
+                self.pos = suffix_end + 1;
+            } else {
+                // NUL-terminated, then padded so the entry is a multiple of 8 bytes
+                const name_end = std.mem.indexOfScalarPos(u8, data, pos, 0) orelse return error.InvalidIndex;
+                entry.path = data[pos..name_end];
+                self.pos = start + std.mem.alignForward(usize, name_end - start + 1, 8);
+            }
+            self.read += 1;
+            return entry;
+        }
+    };
+};
+
+fn parseTreeRoot(body: []const u8) ?[oid_len]u8 {
+    // "<path>\0<entry_count> <subtree_count>\n<oid>", the root has an empty path
+    if (body.len == 0 or body[0] != 0) return null;
+    const line_end = std.mem.indexOfScalar(u8, body, '\n') orelse return null;
+    const space = std.mem.indexOfScalar(u8, body[1..line_end], ' ') orelse return null;
+    const entry_count = std.fmt.parseInt(i32, body[1..][0..space], 10) catch return null;
+    if (entry_count < 0 or body.len < line_end + 1 + oid_len) return null;
+    return body[line_end + 1 ..][0..oid_len].*;
+}
+
+/// Git's offset varint (index v4): each continuation adds one before shifting.
+fn readVarint(data: []const u8, pos: *usize) !usize {
+    if (pos.* >= data.len) return error.InvalidIndex;
+    var byte = data[pos.*];
+    pos.* += 1;
+    var value: usize = byte & 0x7f;
+    while (byte & 0x80 != 0) {
+        if (pos.* >= data.len or value > (std.math.maxInt(usize) >> 8)) return error.InvalidIndex;
+        byte = data[pos.*];
+        pos.* += 1;
+        value = ((value + 1) << 7) | (byte & 0x7f);
+    }
+    return value;
+}
+
+fn readU32(data: []const u8, pos: usize) u32 {
+    return std.mem.readInt(u32, data[pos..][0..4], .big);
+}
+
+fn readU16(data: []const u8, pos: usize) u16 {
+    return std.mem.readInt(u16, data[pos..][0..2], .big);
+}
+
+// ───────────────────────────────────────────────────────────
+// Tracked entries under the listed directory
+// ───────────────────────────────────────────────────────────
+
+const Tracked = struct {
+    files: std.StringHashMapUnmanaged(Entry) = .empty, // Keyed by path relative to the listed dir
+    dirs: std.StringHashMapUnmanaged(void) = .empty, // Every directory holding a tracked file
+    seen: u32 = 0,
+    extensions_offset: usize = 0,
+    index_mtime_s: u32,
+    stop: ?*const std.atomic.Value(bool) = null, // Checked once per directory
+    budget: u32 = max_walk_names, // Names left to visit
+
+    fn collect(allocator: std.mem.Allocator, index: Index, rel: []const u8, index_mtime_s: u32) !Tracked {
+        var self = Tracked{ .index_mtime_s = index_mtime_s };
+        var name_buf: [max_path]u8 = undefined;
+        var it = index.iterator(&name_buf);
+        while (try it.next()) |entry| {
+            const path = relativeTo(entry.path, rel) orelse continue;
+            if (!isPlainEntry(entry)) return error.Unsupported;
+
+            const key = if (index.version == 4) try allocator.dupe(u8, path) else path;
+            try self.files.put(allocator, key, entry);
+            var slash = std.mem.lastIndexOfScalar(u8, key, '/');
+            while (slash) |end| : (slash = std.mem.lastIndexOfScalar(u8, key[0..end], '/')) {
+                const gop = try self.dirs.getOrPut(allocator, key[0..end]);
+                if (gop.found_existing) break; // Its ancestors are in already
+            }
+        }
+        if (index.hasUnsupportedExtension(it.pos)) return error.Unsupported;
+        self.extensions_offset = it.pos;
+        return self;
+    }
+
+    const WalkError = std.fs.Dir.Iterator.Error || std.fs.Dir.OpenError || std.posix.FStatAtError ||
+        error{ NameTooLong, Modified, Untracked, Cancelled, TooLarge };
+
+    /// Compare every name under `dir` with the index. Untracked (or ignored)
+    /// names, stat mismatches and running out of budget end the walk: git
+    /// has to look at those.
+    fn walk(self: *Tracked, dir: std.fs.Dir, path_buf: *[max_path]u8, path_len: usize, at_root: bool) WalkError!void {
+        if (self.stop) |stop| if (stop.load(.monotonic)) return error.Cancelled;
+        var it = dir.iterate();
+        while (try it.next()) |child| {
+            if (at_root and std.mem.eql(u8, child.name, ".git")) continue;
+            if (self.budget == 0) return error.TooLarge;
+            self.budget -= 1;
+
+            const sep = @intFromBool(path_len > 0);
+            if (path_len + sep + child.name.len > max_path) return error.NameTooLong;
+            if (sep == 1) path_buf[path_len] = '/';
+            @memcpy(path_buf[path_len + sep ..][0..child.name.len], child.name);
+            const path = path_buf[0 .. path_len + sep + child.name.len];
+
+            if (self.files.get(path)) |entry| {
+                const st = try std.posix.fstatat(dir.fd, child.name, std.posix.AT.SYMLINK_NOFOLLOW);
+                if (!matchesStat(entry, st, self.index_mtime_s)) return error.Modified;
+                self.seen += 1;
+            } else if (child.kind == .directory and self.dirs.contains(path)) {
+                var sub = try dir.openDir(child.name, .{ .iterate = true });
+                defer sub.close();
+                try self.walk(sub, path_buf, path.len, false);
+            } else {
+                return error.Untracked;
+            }
+        }
+    }
+};
+
+/// Path relative to `rel` if the entry lives under it.
+fn relativeTo(path: []const u8, rel: []const u8) ?[]const u8 {
+    if (rel.len == 0) return path;
+    if (path.len <= rel.len or path[rel.len] != '/' or !std.mem.startsWith(u8, path, rel)) return null;
+    return path[rel.len + 1 ..];
+}
+
+/// Stage-0 regular file or symlink, with no flags that change its meaning.
+fn isPlainEntry(entry: Entry) bool {
+    if (entry.stage() != 0) return false; // Unmerged
+    if (entry.ext_flags & (Entry.ext_skip_worktree | Entry.ext_intent_to_add) != 0) return false;
+    return switch (entry.mode) {
+        0o100644, 0o100755, 0o120000 => true,
+        else => false, // Gitlinks (submodules) and sparse directory entries
+    };
+}
+
+/// Git's own stat check (ie_match_stat with core.checkStat=default),
+/// plus the racy-git rule: an entry written in the same second as the
+/// index may have changed without its stat data showing it.
+fn matchesStat(entry: Entry, st: std.posix.Stat, index_mtime_s: u32) bool {
+    const S = std.posix.S;
+    const type_ok = switch (entry.mode) {
+        0o100644, 0o100755 => S.ISREG(st.mode) and ((entry.mode ^ st.mode) & S.IXUSR) == 0,
+        0o120000 => S.ISLNK(st.mode),
+        else => false,
+    };
+    const mtime = st.mtime();
+    const ctime = st.ctime();
+    return type_ok and
+        entry.mtime_s < index_mtime_s and
+        entry.mtime_s == low32(mtime.sec) and entry.mtime_ns == low32(mtime.nsec) and
+        entry.ctime_s == low32(ctime.sec) and entry.ctime_ns == low32(ctime.nsec) and
+        entry.ino == low32(st.ino) and entry.uid == st.uid and entry.gid == st.gid and
+        entry.size == low32(st.size);
+}
+
+/// The index stores 32-bit stat fields; compare the low bits like git does.
+fn low32(value: anytype) u32 {
+    const wide: i128 = value;
+    return @truncate(@as(u128, @bitCast(wide)));
+}
+
+// ───────────────────────────────────────────────────────────
+// HEAD's tree
+// ───────────────────────────────────────────────────────────
+
+fn headTree(allocator: std.mem.Allocator, git_dir: std.fs.Dir) ![oid_len]u8 {
+    var buf: [256]u8 = undefined;
+    const head = std.mem.trim(u8, try git_dir.readFile("HEAD", &buf), &std.ascii.whitespace);
+    const commit = if (std.mem.startsWith(u8, head, "ref: "))
+        try resolveRef(allocator, git_dir, head["ref: ".len..])
+    else
+        try parseOid(head);
+    return commitTree(allocator, git_dir, commit);
+}
+
+fn resolveRef(allocator: std.mem.Allocator, git_dir: std.fs.Dir, name: []const u8) ![oid_len]u8 {
+    var buf: [256]u8 = undefined;
+    if (git_dir.readFile(name, &buf)) |content| {
+        return parseOid(std.mem.trim(u8, content, &std.ascii.whitespace));
+    } else |err| if (err != error.FileNotFound) return err;
+
+    // "<hex> <refname>" lines; '#' headers and '^' peeled tags skipped
+    const packed_refs = try git_dir.readFileAlloc(allocator, "packed-refs", 64 * 1024 * 1024);
+    var lines = std.mem.splitScalar(u8, packed_refs, '\n');
+    while (lines.next()) |line| {
+        if (line.len < oid_len * 2 + 1 or line[oid_len * 2] != ' ') continue;
+        if (std.mem.eql(u8, line[oid_len * 2 + 1 ..], name)) return parseOid(line[0 .. oid_len * 2]);
+    }
+    return error.Unsupported; // Unborn branch
+}
+
+fn parseOid(hex: []const u8) ![oid_len]u8 {
+    if (hex.len != oid_len * 2) return error.Unsupported;
+    var oid: [oid_len]u8 = undefined;
+    _ = try std.fmt.hexToBytes(&oid, hex);
+    return oid;
+}
+
+/// Tree id from a commit object, loose or (undeltified) in a pack.
+fn commitTree(allocator: std.mem.Allocator, git_dir: std.fs.Dir, commit: [oid_len]u8) ![oid_len]u8 {
+    var out: [64]u8 = undefined;
+    const hex = std.fmt.bytesToHex(commit, .lower);
+    var loose_path: [8 + oid_len * 2 + 1]u8 = undefined;
+    const loose = try std.fmt.bufPrint(&loose_path, "objects/{s}/{s}", .{ hex[0..2], hex[2..] });
+
+    const body = if (git_dir.openFile(loose, .{})) |file| blk: {
+        defer file.close();
+        var read_buf: [4096]u8 = undefined;
+        var reader = file.readerStreaming(&read_buf);
+        const raw = try inflatePrefix(&reader.interface, &out);
+        // Loose objects start with "commit <size>\0"
+        if (!std.mem.startsWith(u8, raw, "commit ")) return error.Unsupported;
+        const nul = std.mem.indexOfScalar(u8, raw, 0) orelse return error.Unsupported;
+        break :blk raw[nul + 1 ..];
+    } else |err| switch (err) {
+        error.FileNotFound => try packedCommit(allocator, git_dir, commit, &out),
+        else => return err,
+    };
+
+    if (body.len < 5 + oid_len * 2 or !std.mem.startsWith(u8, body, "tree ")) return error.Unsupported;
+    return parseOid(body[5..][0 .. oid_len * 2]);
+}
+
+/// Start of a commit stored whole in a pack (v2 .idx lookup).
+fn packedCommit(allocator: std.mem.Allocator, git_dir: std.fs.Dir, commit: [oid_len]u8, out: []u8) ![]u8 {
+    var pack_dir = try git_dir.openDir("objects/pack", .{ .iterate = true });
+    defer pack_dir.close();
+
+    var it = pack_dir.iterate();
+    while (try it.next()) |child| {
+        if (!std.mem.endsWith(u8, child.name, ".idx")) continue;
+        const idx_file = try pack_dir.openFile(child.name, .{});
+        defer idx_file.close();
+        const idx = try mapFile(idx_file);
+        defer std.posix.munmap(idx);
+
+        const offset = (try packOffset(idx, commit)) orelse continue;
+        const pack_name = try std.mem.concat(allocator, u8, &.{ child.name[0 .. child.name.len - ".idx".len], ".pack" });
+        const pack = try pack_dir.openFile(pack_name, .{});
+        defer pack.close();
+
+        var read_buf: [4096]u8 = undefined;
+        var reader = pack.reader(&read_buf);
+        try reader.seekTo(offset);
+        // Object header: type in bits 4-6 of the first byte, size varint after
+        var byte = try reader.interface.takeByte();
+        if ((byte >> 4) & 7 != 1) return error.Unsupported; // Not a whole commit (e.g. a delta)
+        while (byte & 0x80 != 0) byte = try reader.interface.takeByte();
+        return inflatePrefix(&reader.interface, out);
+    }
+    return error.Unsupported;
+}
+
+/// Offset of `oid` in a version 2 pack index, or null if it isn't there.
+fn packOffset(idx: []const u8, oid: [oid_len]u8) !?u64 {
+    const fanout_at = 8;
+    if (idx.len < fanout_at + 256 * 4 + oid_len * 2 or !std.mem.eql(u8, idx[0..8], "\xfftOc\x00\x00\x00\x02")) return error.Unsupported;
+    const total: usize = readU32(idx, fanout_at + 255 * 4);
+    const oids_at = fanout_at + 256 * 4;
+    const offsets_at = oids_at + total * (oid_len + 4); // After object ids and CRCs
+    if (idx.len < offsets_at + total * 4) return error.Unsupported;
+
+    var lo: usize = if (oid[0] == 0) 0 else readU32(idx, fanout_at + (@as(usize, oid[0]) - 1) * 4);
+    var hi: usize = readU32(idx, fanout_at + @as(usize, oid[0]) * 4);
+    if (hi > total) return error.Unsupported;
+    while (lo < hi) {
+        const mid = lo + (hi - lo) / 2;
+        switch (std.mem.order(u8, idx[oids_at + mid * oid_len ..][0..oid_len], &oid)) {
+            .lt => lo = mid + 1,
+            .gt => hi = mid,
+            .eq => {
+                const small = readU32(idx, offsets_at + mid * 4);
+                if (small & 0x8000_0000 == 0) return small;
+                const large_at = offsets_at + total * 4 + @as(usize, small & 0x7fff_ffff) * 8;
+                if (idx.len < large_at + 8) return error.Unsupported;
+                return std.mem.readInt(u64, idx[large_at..][0..8], .big);
+            },
+        }
+    }
+    return null;
+}
+
+/// First bytes of a zlib stream, enough for a commit's "tree <hex>" line.
+fn inflatePrefix(input: *std.Io.Reader, out: []u8) ![]u8 {
+    var window: [std.compress.flate.max_window_len]u8 = undefined;
+    var inflate: std.compress.flate.Decompress = .init(input, .zlib, &window);
+    const n = try inflate.reader.readSliceShort(out);
+    return out[0..n];
+}
+
+// ═══════════════════════════════════════════════════════════
+// TESTS
+// ═══════════════════════════════════════════════════════════
+
+fn appendInt(list: *std.ArrayList(u8), allocator: std.mem.Allocator, comptime T: type, value: T) !void {
+    var bytes: [@sizeOf(T)]u8 = undefined;
+    std.mem.writeInt(T, &bytes, value, .big);
+    try list.appendSlice(allocator, &bytes);
+}
+
+fn testEntry(mode: u32) Entry {
+    var entry: Entry = undefined;
+    inline for (std.meta.fields(Entry)) |field| {
+        if (field.type == u32 or field.type == u16) @field(entry, field.name) = 0;
+    }
+    entry.mode = mode;
+    entry.path = "";
+    return entry;
+}
+
+/// Serialize entries as a v2 (padded) or v4 (prefix-compressed) index.
+fn testIndex(allocator: std.mem.Allocator, version: u32, paths: []const []const u8, tree_ext: []const u8) ![]u8 {
+    var out: std.ArrayList(u8) = .empty;
+    errdefer out.deinit(allocator);
+    try out.appendSlice(allocator, "DIRC");
+    try appendInt(&out, allocator, u32, version);
+    try appendInt(&out, allocator, u32, @intCast(paths.len));
+    var prev: []const u8 = "";
+    for (paths, 0..) |path, i| {
+        const start = out.items.len;
+        for (0..10) |field| try appendInt(&out, allocator, u32, if (field == 6) 0o100644 else @intCast(i + field));
+        try out.appendNTimes(allocator, 0xab, oid_len);
+        try appendInt(&out, allocator, u16, @intCast(@min(path.len, 0xfff)));
+        if (version == 4) {
+            const common = std.mem.indexOfDiff(u8, prev, path) orelse prev.len;
+            try out.append(allocator, @intCast(prev.len - common)); // < 128: one varint byte
+            try out.appendSlice(allocator, path[common..]);
+            try out.append(allocator, 0);
+            prev = path;
+        } else {
+            try out.appendSlice(allocator, path);
+            const len = std.mem.alignForward(usize, out.items.len - start + 1, 8);
+            try out.appendNTimes(allocator, 0, start + len - out.items.len);
+        }
+    }
+    try out.appendSlice(allocator, tree_ext);
+    try out.appendNTimes(allocator, 0, oid_len); // Checksum (not verified)
+    return out.toOwnedSlice(allocator);
+}
+
+test "Index - v2 entries with padding" {
+    const allocator = std.testing.allocator;
+    const data = try testIndex(allocator, 2, &.{ "README.md", "src/a.zig", "src/lib/b.zig" }, "");
+    defer allocator.free(data);
+
+    const index = try Index.parse(data);
+    var name_buf: [max_path]u8 = undefined;
+    var it = index.iterator(&name_buf);
+    const first = (try it.next()).?;
+    try std.testing.expectEqualStrings("README.md", first.path);
+    try std.testing.expectEqual(@as(u32, 0o100644), first.mode);
+    try std.testing.expectEqual(@as(u32, 2), first.mtime_s);
+    try std.testing.expectEqualStrings("src/a.zig", (try it.next()).?.path);
+    try std.testing.expectEqualStrings("src/lib/b.zig", (try it.next()).?.path);
+    try std.testing.expect((try it.next()) == null);
+    try std.testing.expectEqual(data.len - oid_len, it.pos);
+}
+
+test "Index - v4 prefix-compressed names" {
+    const allocator = std.testing.allocator;
+    const data = try testIndex(allocator, 4, &.{ "src/a.zig", "src/ab.zig", "src/lib/b.zig", "z" }, "");
+    defer allocator.free(data);
+
+    const index = try Index.parse(data);
+    var name_buf: [max_path]u8 = undefined;
+    var it = index.iterator(&name_buf);
+    for ([_][]const u8{ "src/a.zig", "src/ab.zig", "src/lib/b.zig", "z" }) |expected| {
+        try std.testing.expectEqualStrings(expected, (try it.next()).?.path);
+    }
+    try std.testing.expect((try it.next()) == null);
+}
+
+test "Index - rejects bad headers" {
+    try std.testing.expectError(error.InvalidIndex, Index.parse("DIRX" ++ "\x00" ** 40));
+    try std.testing.expectError(error.InvalidIndex, Index.parse("DIRC\x00\x00\x00\x05" ++ "\x00" ** 40));
+}
+
+test "Index cacheTreeRoot - valid and invalidated roots" {
+    const allocator = std.testing.allocator;
+    const oid = "\x11" ** oid_len;
+    const valid = "TREE" ++ "\x00\x00\x00\x19" ++ "\x003 1\n" ++ oid;
+    const data = try testIndex(allocator, 2, &.{"a"}, valid);
+    defer allocator.free(data);
+    const index = try Index.parse(data);
+    try std.testing.expectEqualSlices(u8, oid, &index.cacheTreeRoot(Index.header_len + 64).?);
+
+    const invalid = "TREE" ++ "\x00\x00\x00\x06" ++ "\x00-1 1\n";
+    const stale = try testIndex(allocator, 2, &.{"a"}, invalid);
+    defer allocator.free(stale);
+    try std.testing.expect((try Index.parse(stale)).cacheTreeRoot(Index.header_len + 64) == null);
+}
+
+test "readVarint - git offset encoding" {
+    var pos: usize = 0;
+    try std.testing.expectEqual(@as(usize, 5), try readVarint("\x05", &pos));
+    pos = 0;
+    // 0x80 0x00 decodes to (0 + 1) << 7 = 128
+    try std.testing.expectEqual(@as(usize, 128), try readVarint("\x80\x00", &pos));
+    try std.testing.expectEqual(@as(usize, 2), pos);
+}
+
+test "relativeTo - entries under the listed directory" {
+    try std.testing.expectEqualStrings("a/b", relativeTo("a/b", "").?);
+    try std.testing.expectEqualStrings("b.zig", relativeTo("src/b.zig", "src").?);
+    try std.testing.expect(relativeTo("srcx/b.zig", "src") == null);
+    try std.testing.expect(relativeTo("src", "src") == null);
+}
+
+test "isPlainEntry - unmerged, flagged and gitlink entries go to git" {
+    var entry = testEntry(0o100644);
+    try std.testing.expect(isPlainEntry(entry));
+    entry.flags = 2 << 12; // Stage 2
+    try std.testing.expect(!isPlainEntry(entry));
+    entry.flags = 0;
+    entry.ext_flags = Entry.ext_intent_to_add;
+    try std.testing.expect(!isPlainEntry(entry));
+    entry.ext_flags = 0;
+    entry.mode = 0o160000;
+    try std.testing.expect(!isPlainEntry(entry));
+}
+
+test "matchesStat - cached stat data against lstat" {
+    var tmp = std.testing.tmpDir(.{});
+    defer tmp.cleanup();
+    try tmp.dir.writeFile(.{ .sub_path = "f", .data = "hello" });
+    const st = try std.posix.fstatat(tmp.dir.fd, "f", std.posix.AT.SYMLINK_NOFOLLOW);
+
+    var entry = testEntry(0o100644);
+    entry.mtime_s = low32(st.mtime().sec);
+    entry.mtime_ns = low32(st.mtime().nsec);
+    entry.ctime_s = low32(st.ctime().sec);
+    entry.ctime_ns = low32(st.ctime().nsec);
+    entry.ino = low32(st.ino);
+    entry.uid = st.uid;
+    entry.gid = st.gid;
+    entry.size = 5;
+
+    try std.testing.expect(matchesStat(entry, st, entry.mtime_s + 1));
+    // Racy: written in the same second as the index
+    try std.testing.expect(!matchesStat(entry, st, entry.mtime_s));
+    entry.size = 6;
+    try std.testing.expect(!matchesStat(entry, st, entry.mtime_s + 1));
+}
+
+test "packOffset - fanout and binary search over a v2 idx" {
+    const allocator = std.testing.allocator;
+    const oids = [_][oid_len]u8{
+        [_]u8{0x10} ** oid_len,
+        [_]u8{0x10} ++ [_]u8{0x20} ** (oid_len - 1),
+        [_]u8{0xf0} ** oid_len,
+    };
+    var idx: std.ArrayList(u8) = .empty;
+    defer idx.deinit(allocator);
+    try idx.appendSlice(allocator, "\xfftOc\x00\x00\x00\x02");
+    for (0..256) |b| {
+        var count: u32 = 0;
+        for (oids) |oid| count += @intFromBool(oid[0] <= b);
+        try appendInt(&idx, allocator, u32, count);
+    }
+    for (oids) |oid| try idx.appendSlice(allocator, &oid);
+    try idx.appendNTimes(allocator, 0, oids.len * 4); // CRCs
+    for (oids, 0..) |_, i| try appendInt(&idx, allocator, u32, @intCast(100 * (i + 1)));
+
+    try std.testing.expectEqual(@as(?u64, 200), try packOffset(idx.items, oids[1]));
+    try std.testing.expectEqual(@as(?u64, 300), try packOffset(idx.items, oids[2]));
+    try std.testing.expectEqual(@as(?u64, null), try packOffset(idx.items, [_]u8{0x11} ** oid_len));
+}
+
+test "Tracked walk - stops once its name budget is spent" {
+    var tmp = std.testing.tmpDir(.{ .iterate = true });
+    defer tmp.cleanup();
+    try tmp.dir.writeFile(.{ .sub_path = "a", .data = "" });
+
+    var path_buf: [max_path]u8 = undefined;
+    var tracked = Tracked{ .index_mtime_s = 0, .budget = 0 };
+    try std.testing.expectError(error.TooLarge, tracked.walk(tmp.dir, &path_buf, 0, true));
+    // With budget left the same untracked name ends the walk instead
+    tracked.budget = 1;
+    try std.testing.expectError(error.Untracked, tracked.walk(tmp.dir, &path_buf, 0, true));
+}
+
+test "walkUp - prefix of a nested directory" {
+    var tmp = std.testing.tmpDir(.{});
+    defer tmp.cleanup();
+    try tmp.dir.makePath("repo/.git");
+    try tmp.dir.writeFile(.{ .sub_path = "repo/.git/HEAD", .data = "ref: refs/heads/main\n" });
+    try tmp.dir.makePath("repo/a/b");
+
+    var root_buf: [max_path]u8 = undefined;
+    const root = try tmp.dir.realpath("repo", &root_buf);
+    var buf: [max_path]u8 = undefined;
+    const sub_path = try tmp.dir.realpath("repo/a/b", &buf);
+
+    const worktree = (try walkUp(sub_path, "", false)).?;
+    try std.testing.expectEqualStrings(root, worktree.root());
+    try std.testing.expectEqualStrings("a/b", worktree.prefix());
+    try std.testing.expect(worktree.git_is_dir);
+
+    // Inside .git itself git status refuses to run
+    var git_buf: [max_path]u8 = undefined;
+    try std.testing.expect((try walkUp(try tmp.dir.realpath("repo/.git", &git_buf), "", false)) == null);
+}
+
+test "walkUp - gitfiles, HEAD-less .git directories and ceilings" {
+    var tmp = std.testing.tmpDir(.{});
+    defer tmp.cleanup();
+    try tmp.dir.makePath("wt/sub/.git"); // No HEAD: git keeps walking up
+    try tmp.dir.writeFile(.{ .sub_path = "wt/.git", .data = "gitdir: /elsewhere/.git/worktrees/wt\n" });
+
+    var wt_buf: [max_path]u8 = undefined;
+    const wt = try tmp.dir.realpath("wt", &wt_buf);
+    var buf: [max_path]u8 = undefined;
+    const sub = try tmp.dir.realpath("wt/sub", &buf);
+
+    const worktree = (try walkUp(sub, "", false)).?;
+    try std.testing.expectEqualStrings(wt, worktree.root());
+    try std.testing.expect(!worktree.git_is_dir);
+
+    // A ceiling at wt stops the walk before it is searched...
+    try std.testing.expect((try walkUp(sub, wt, false)) == null);
+    // ...but the starting directory is always searched
+    try std.testing.expect((try walkUp(wt, wt, false)) != null);
+}
+
+test "ceilingLength - longest proper ancestor, relative entries ignored" {
+    try std.testing.expectEqual(@as(usize, 1), ceilingLength("/nonexistent-lg/a/b", "relative:/nonexistent-lg/a/b:/"));
+    try std.testing.expectEqual(@as(usize, 0), ceilingLength("/nonexistent-lg/a", "/nonexistent-lg/a:relative"));
+    try std.testing.expectEqual(@as(usize, 17), ceilingLength("/nonexistent-lg/a/b", "/:/nonexistent-lg/a/:/nonexistent-lg"));
+}
+
+test "envBool - git boolean spellings" {
+    try std.testing.expect(envBool("1"));
+    try std.testing.expect(envBool("True"));
+    try std.testing.expect(!envBool("0"));
+    try std.testing.expect(!envBool(null));
+}
@@ -1,7 +1,10 @@
 //! Entry point for zig-lg - ls with git status integration.
 //!
 //! Memory management: Arena allocator (single deinit() frees everything)
-//! Execution flow: CLI parse → git status → list files → sort → display
+//! Execution flow: CLI parse → git status (own thread) ∥ list files → sort
+//! → join git statuses → display
+//! (-U streams instead: list and display chunk by chunk, git joined at the first chunk)
+//! (-d on a terminal walks after sorting and redraws rows as sums arrive)
 //! All allocations freed on exit - perfect for short-lived CLI tools
 
 const std = @import("std");
@@ -13,7 +16,13 @@ const git = @import("git.zig");
 const filesystem = @import("filesystem.zig");
 const display = @import("display.zig");
 
+/// Exit status when --git-timeout killed git: the listing is complete but
+/// its git column is all "unknown"
+const EXIT_GIT_DEGRADED = 3;
+
 pub fn main() !void {
+    var timing = Timing.init();
+
     // Arena allocator: all allocations freed with single deinit()
     // Why arena? Short-lived CLI tool, no need for granular tracking
     // All memory released when program exits anyway
@@ -30,45 +39,209 @@ pub fn main() !void {
         return err;
     };
 
-    // Get git status (optional - may fail if not a git repo)
-    var git_ctx: ?git.GitContext = git.GitContext.init(allocator, config.dir_path) catch null;
-    defer if (git_ctx) |*ctx| ctx.deinit();
+    // Start git status first: it runs on its own thread while the directory
+    // is enumerated and stat-ed, and its result is joined on at the end
+    // (optional - null if not a git repo)
+    var pending_git: git.Pending = undefined;
+    pending_git.start(config.dir_path, config.git);
+    defer pending_git.deinit();
+
+    // Unsorted: render chunks as they are read, in bounded memory
+    if (filesystem.canStream(config)) {
+        var buffer: [display.STREAM_BUFFER_SIZE]u8 = undefined;
+        var out = std.fs.File.stdout().writer(&buffer);
+        var sink = GitJoinSink{
+            .inner = .{ .renderer = .init(&out.interface, null, config) },
+            .pending = &pending_git,
+            .timing = &timing,
+            .config = config,
+        };
+        timing.list_start_ns = Timing.now();
+        streamListing(allocator, config, &sink) catch |err| {
+            // Reader went away (lg -U1 | head): stop quietly
+            if (err == error.WriteFailed and out.err == error.BrokenPipe) return;
+            return err;
+        };
+        timing.list_end_ns = Timing.now();
+        timing.end_ns = timing.list_end_ns;
+        if (config.show_timing) timing.report(&pending_git, false);
+        if (pending_git.timed_out) std.process.exit(EXIT_GIT_DEGRADED);
+        return;
+    }
+
+    // Collect and sort files while git runs
+    timing.list_start_ns = Timing.now();
+    var listing = try filesystem.listFiles(allocator, config);
+    // No need to free - arena handles it
+    // --counts: descendant counts from the -d walk, looked up by name
+    var counts: types.TreeCounts = .empty;
+    const counts_ptr: ?*types.TreeCounts = if (config.show_counts) &counts else null;
+    if (config.show_counts) listing.counts = &counts;
+    // -d sums: on a terminal they fill in on screen, unless the order needs them
+    const live = config.calc_dir_sizes and !config.sort_by_size and display.canShowLive(std.fs.File.stdout(), config);
+    if (config.calc_dir_sizes and !live) try filesystem.calculateDirSizes(allocator, listing, config, counts_ptr);
+    filesystem.sortFiles(listing, config);
+    var dir_sizes: ?filesystem.DirSizes = if (live) try filesystem.DirSizes.start(allocator, listing, config, counts_ptr) else null;
+    defer if (dir_sizes) |*sizes| sizes.deinit();
+    timing.list_end_ns = Timing.now();
+
+    // Final pass: join git statuses onto the entries
+    const git_ctx = timing.joinGit(&pending_git);
+    if (git_ctx) |ctx| ctx.annotate(listing);
+    try showHeader(config, git_ctx);
+
+    // Display
+    if (dir_sizes) |*sizes| {
+        try showLive(allocator, listing, git_ctx, config, sizes);
+    } else {
+        try display.print(allocator, std.fs.File.stdout(), listing, git_ctx, config);
+    }
+    timing.end_ns = Timing.now();
+    if (config.show_timing) timing.report(&pending_git, true);
+    if (pending_git.timed_out) std.process.exit(EXIT_GIT_DEGRADED);
+}
+
+/// Streaming sink that joins git onto each chunk before it is rendered.
+/// The first chunk waits for `git status` (the header needs to know whether
+/// there is a Git column), so git still overlaps enumeration of that chunk.
+const GitJoinSink = struct {
+    inner: display.StreamSink,
+    pending: *git.Pending,
+    timing: *Timing,
+    config: types.Config,
+    joined: bool = false,
 
-    // Show git info if requested
+    pub fn emit(self: *GitJoinSink, chunk: types.Listing) !void {
+        try self.join();
+        if (self.inner.renderer.git_ctx) |ctx| ctx.annotate(chunk);
+        try self.inner.emit(chunk);
+    }
+
+    pub fn finish(self: *GitJoinSink) !void {
+        try self.join();
+        try self.inner.finish();
+    }
+
+    fn join(self: *GitJoinSink) !void {
+        if (self.joined) return;
+        self.joined = true;
+        self.inner.renderer.git_ctx = self.timing.joinGit(self.pending);
+        try showHeader(self.config, self.inner.renderer.git_ctx);
+    }
+};
+
+/// --branch and --legend lines, printed once git has been joined: the
+/// branch comes from the same `git status` run as the file statuses.
+fn showHeader(config: types.Config, git_ctx: ?*const git.GitContext) !void {
     if (config.show_branch) {
-        try showBranch(allocator);
+        if (git_ctx) |ctx| try showBranch(ctx.branch);
     }
     if (config.show_legend) {
         try showLegend();
     }
+}
 
-    // Collect files
-    const files = try filesystem.listFiles(allocator, config, if (git_ctx) |*ctx| ctx else null);
-    // No need to free - arena handles it
+/// Draw the listing with -d sums pending and redraw rows as subtrees
+/// finish, at most once per frame. A listing taller than the terminal
+/// can't be redrawn: it waits for the sums and renders once.
+fn showLive(
+    allocator: std.mem.Allocator,
+    listing: types.Listing,
+    git_ctx: ?*const git.GitContext,
+    config: types.Config,
+    sizes: *filesystem.DirSizes,
+) !void {
+    const stdout = std.fs.File.stdout();
+    var live: display.Live = undefined;
+    if (!try live.begin(allocator, stdout, listing, git_ctx, config)) {
+        try sizes.finish(listing);
+        return display.print(allocator, stdout, listing, git_ctx, config);
+    }
+    defer live.deinit();
 
-    // Sort files
-    filesystem.sortFiles(files, config);
+    while (sizes.wait(std.math.maxInt(u64))) {
+        sizes.apply(listing);
+        try live.refresh();
+        if (sizes.running()) std.Thread.sleep(display.LIVE_FRAME_NS);
+    }
+    try sizes.finish(listing);
+    try live.end();
+}
 
-    // Display
-    try display.print(allocator, files, if (git_ctx) |*ctx| ctx else null, config);
+fn streamListing(allocator: std.mem.Allocator, config: types.Config, sink: *GitJoinSink) !void {
+    try filesystem.streamFiles(allocator, config, sink);
+    try sink.finish();
 }
 
-fn showBranch(allocator: std.mem.Allocator) !void {
-    var child = std.process.Child.init(&.{ "git", "branch", "--show-current" }, allocator);
-    child.stdout_behavior = .Pipe;
-    child.stderr_behavior = .Ignore;
+/// Phase marks for --timing, in std.time.nanoTimestamp units. The git span
+/// comes from git.Pending; the list span covers enumerate, stat and sort
+/// (and rendering too when streaming).
+const Timing = struct {
+    start_ns: i128,
+    list_start_ns: i128 = 0,
+    list_end_ns: i128 = 0,
+    wait_ns: i128 = 0, // Time the listing sat blocked on git
+    joined_ns: i128 = 0,
+    end_ns: i128 = 0,
+
+    fn init() Timing {
+        return .{ .start_ns = now() };
+    }
+
+    fn now() i128 {
+        return std.time.nanoTimestamp();
+    }
 
-    try child.spawn();
+    fn joinGit(self: *Timing, pending: *git.Pending) ?*const git.GitContext {
+        const before = now();
+        const ctx = pending.wait();
+        self.joined_ns = now();
+        self.wait_ns = self.joined_ns - before;
+        return ctx;
+    }
 
-    const stdout = try child.stdout.?.readToEndAlloc(allocator, 1024);
-    defer allocator.free(stdout);
+    fn report(self: Timing, pending: *const git.Pending, show_render: bool) void {
+        var buffer: [1024]u8 = undefined;
+        var stderr = std.fs.File.stderr().writer(&buffer);
+        self.write(&stderr.interface, pending.started_ns, pending.finished_ns, show_render) catch return;
+        if (pending.timed_out) stderr.interface.writeAll("timing: git killed at --git-timeout\n") catch return;
+        stderr.interface.flush() catch {};
+    }
+
+    fn write(self: Timing, writer: *std.Io.Writer, git_start: i128, git_end: i128, show_render: bool) !void {
+        const git_ns = git_end - git_start;
+        const shared = overlap(git_start, git_end, self.list_start_ns, self.list_end_ns);
+        const hidden: i128 = if (git_ns > 0) @divTrunc(shared * 100, git_ns) else 0;
+
+        try writer.print("timing: git     {d:>9.2} ms  (+{d:.2} .. +{d:.2})\n", .{ ms(git_ns), ms(git_start - self.start_ns), ms(git_end - self.start_ns) });
+        try writer.print("timing: list    {d:>9.2} ms  (+{d:.2} .. +{d:.2})\n", .{ ms(self.list_end_ns - self.list_start_ns), ms(self.list_start_ns - self.start_ns), ms(self.list_end_ns - self.start_ns) });
+        try writer.print("timing: overlap {d:>9.2} ms  ({d}% of git hidden behind listing)\n", .{ ms(shared), hidden });
+        try writer.print("timing: wait    {d:>9.2} ms  (blocked on git)\n", .{ms(self.wait_ns)});
+        if (show_render) {
+            try writer.print("timing: render  {d:>9.2} ms\n", .{ms(self.end_ns - self.joined_ns)});
+        }
+        try writer.print("timing: total   {d:>9.2} ms\n", .{ms(self.end_ns - self.start_ns)});
+    }
 
-    _ = try child.wait();
+    /// Nanoseconds shared by the spans [a_start, a_end) and [b_start, b_end).
+    fn overlap(a_start: i128, a_end: i128, b_start: i128, b_end: i128) i128 {
+        return @max(0, @min(a_end, b_end) - @max(a_start, b_start));
+    }
 
-    const branch = std.mem.trim(u8, stdout, &std.ascii.whitespace);
-    if (branch.len > 0) {
-        std.debug.print("Branch: {s}\n\n", .{branch});
+    fn ms(ns: i128) f64 {
+        return @as(f64, @floatFromInt(ns)) / std.time.ns_per_ms;
     }
+};
+
+fn showBranch(branch: git.Branch) !void {
+    if (branch.head == null) return; // Not a repository, or git timed out
+    var buffer: [1024]u8 = undefined;
+    var stderr = std.fs.File.stderr().writer(&buffer);
+    const writer = &stderr.interface;
+    try writer.writeAll("Branch: ");
+    try branch.write(writer);
+    try writer.writeAll("\n\n");
+    try writer.flush();
 }
 
 fn showLegend() !void {
@@ -98,19 +271,9 @@ test "showLegend prints without error" {
     try showLegend();
 }
 
-test "showBranch handles git failure gracefully" {
-    // Test that showBranch doesn't crash even if git fails
-    const allocator = std.testing.allocator;
-
-    // This may fail if not in a git repo, but shouldn't crash
-    showBranch(allocator) catch |err| {
-        // Expected errors when git is not available or not in a repo
-        try std.testing.expect(
-            err == error.FileNotFound or
-                err == error.BrokenPipe or
-                err == std.process.Child.SpawnError.InvalidExe,
-        );
-    };
+test "showBranch skips a missing head" {
+    // No git result (not a repository): prints nothing
+    try showBranch(.{});
 }
 
 test "arena allocator cleanup" {
@@ -127,3 +290,31 @@ test "arena allocator cleanup" {
     // No need to free - arena handles it
     // This test passes if no memory leaks occur
 }
+
+test "Timing overlap - shared span of two phases" {
+    try std.testing.expectEqual(@as(i128, 5), Timing.overlap(0, 10, 5, 20));
+    try std.testing.expectEqual(@as(i128, 10), Timing.overlap(0, 10, 0, 30));
+    try std.testing.expectEqual(@as(i128, 0), Timing.overlap(0, 10, 10, 20));
+    try std.testing.expectEqual(@as(i128, 0), Timing.overlap(15, 20, 0, 10));
+}
+
+test "Timing write - reports overlap and wait" {
+    var buf: [1024]u8 = undefined;
+    var writer: std.Io.Writer = .fixed(&buf);
+    const ms_ns = std.time.ns_per_ms;
+    const timing = Timing{
+        .start_ns = 0,
+        .list_start_ns = 1 * ms_ns,
+        .list_end_ns = 9 * ms_ns,
+        .wait_ns = 3 * ms_ns,
+        .joined_ns = 12 * ms_ns,
+        .end_ns = 14 * ms_ns,
+    };
+    try timing.write(&writer, 0, 12 * ms_ns, true);
+
+    const out = writer.buffered();
+    try std.testing.expect(std.mem.indexOf(u8, out, "timing: overlap      8.00 ms  (66% of git hidden") != null);
+    try std.testing.expect(std.mem.indexOf(u8, out, "timing: wait         3.00 ms") != null);
+    try std.testing.expect(std.mem.indexOf(u8, out, "timing: render       2.00 ms") != null);
+    try std.testing.expect(std.mem.indexOf(u8, out, "timing: total       14.00 ms") != null);
+}
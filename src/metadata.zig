@@ -0,0 +1,392 @@
+//! Per-entry metadata collection for listFiles.
+//!
+//! Fields: Which stat fields the current Config displays or sorts on
+//! statAt: statx with a minimal field mask on Linux, fstatat elsewhere
+//! Network filesystems (NFS, SMB, FUSE, ...) get AT_STATX_DONT_SYNC so the
+//! kernel answers from cached attributes instead of a server round trip.
+
+const std = @import("std");
+const builtin = @import("builtin");
+const types = @import("types.zig");
+const linux = std.os.linux;
+
+// statx(2) mask bits and flags (stable Linux ABI, see include/uapi/linux/stat.h)
+const STATX_TYPE: u32 = 0x0001;
+const STATX_MODE: u32 = 0x0002;
+const STATX_UID: u32 = 0x0008;
+const STATX_GID: u32 = 0x0010;
+const STATX_MTIME: u32 = 0x0040;
+const STATX_INO: u32 = 0x0100;
+const STATX_SIZE: u32 = 0x0200;
+const STATX_BLOCKS: u32 = 0x0400;
+const AT_STATX_DONT_SYNC: u32 = 0x4000;
+
+/// Stat fields needed to display and sort the listing.
+/// File type is not listed: it comes from d_type, and is requested
+/// separately (statAt `need_type`) only when d_type is DT_UNKNOWN.
+pub const Fields = struct {
+    mode: bool = false,  // Permission bits: permissions column, exec color, -F '*'
+    size: bool = false,  // Size column, -s sort, JSON/NDJSON/porcelain
+    mtime: bool = false, // Modified column, default/-T time sort
+    owner: bool = false, // uid/gid for -ll
+    inode: bool = false, // -i column
+    blocks: bool = false, // Allocated size instead of st_size (--size-mode=disk)
+
+    /// Derive the minimal field set from what Config will display or sort on.
+    pub fn fromConfig(config: types.Config) Fields {
+        var fields = Fields{};
+
+        switch (config.output_format) {
+            .json, .ndjson, .porcelain => {
+                fields.mode = true;
+                fields.size = true;
+            },
+            .normal => {
+                if (config.one_column) {
+                    // Names only. Mode is just for exec color and the -F '*' suffix;
+                    // -1 -U skips highlighting entirely, like `ls -f`.
+                    fields.mode = config.file_type_indicators or !config.unsorted;
+                } else {
+                    fields.mode = true;
+                    fields.size = true;
+                    fields.mtime = true;
+                    fields.owner = config.detail_level == .full;
+                    fields.inode = config.show_inodes;
+                }
+            },
+        }
+
+        // Sort keys (mirrors the precedence in filesystem.sortFiles)
+        if (!config.unsorted and !config.sort_by_extension) {
+            if (config.sort_by_size) {
+                fields.size = true;
+            } else if (config.sort_by_time or !config.sort_alphabetical) {
+                fields.mtime = true;
+            }
+        }
+
+        fields.blocks = fields.size and config.size_mode == .disk;
+        return fields;
+    }
+
+    pub fn isEmpty(self: Fields) bool {
+        return !(self.mode or self.size or self.mtime or self.owner or self.inode or self.blocks);
+    }
+
+    /// statx mask for these fields. STATX_TYPE is always requested alongside
+    /// anything else so the returned mode carries valid S_IFMT bits.
+    pub fn statxMask(self: Fields, need_type: bool) u32 {
+        var mask: u32 = 0;
+        if (need_type or !self.isEmpty()) mask |= STATX_TYPE;
+        if (self.mode) mask |= STATX_MODE;
+        if (self.size) mask |= STATX_SIZE;
+        if (self.mtime) mask |= STATX_MTIME;
+        if (self.owner) mask |= STATX_UID | STATX_GID;
+        if (self.inode) mask |= STATX_INO;
+        if (self.blocks) mask |= STATX_BLOCKS;
+        return mask;
+    }
+};
+
+/// Subset of stat data used by FileInfo. Fields not requested are zero.
+pub const Stat = struct {
+    mode: std.posix.mode_t = 0,
+    size: u64 = 0,
+    mtime: i64 = 0, // ns since the epoch, see mtimeNs
+    uid: std.posix.uid_t = 0,
+    gid: std.posix.gid_t = 0,
+    inode: u64 = 0,
+    blocks: u64 = 0, // 512-byte units
+
+    /// Bytes allocated on disk (du's figure) rather than st_size.
+    pub fn diskBytes(self: Stat) u64 {
+        return self.blocks *| 512;
+    }
+
+    pub fn fromPosix(st: std.posix.Stat) Stat {
+        const mtime_ts = st.mtime();
+        return .{
+            .mode = st.mode,
+            // Protect against integer overflow: negative sizes clamp to 0
+            .size = if (st.size < 0) 0 else @intCast(st.size),
+            .mtime = mtimeNs(mtime_ts.sec, mtime_ts.nsec),
+            .uid = st.uid,
+            .gid = st.gid,
+            .inode = st.ino,
+            .blocks = if (st.blocks < 0) 0 else @intCast(st.blocks),
+        };
+    }
+
+    /// Convert a statx result, trusting only the fields the kernel says it filled in.
+    pub fn fromStatx(stx: *const linux.Statx) Stat {
+        return .{
+            .mode = if (stx.mask & (STATX_TYPE | STATX_MODE) != 0) stx.mode else 0,
+            .size = if (stx.mask & STATX_SIZE != 0) stx.size else 0,
+            .mtime = if (stx.mask & STATX_MTIME != 0) mtimeNs(stx.mtime.sec, stx.mtime.nsec) else 0,
+            .uid = if (stx.mask & STATX_UID != 0) stx.uid else 0,
+            .gid = if (stx.mask & STATX_GID != 0) stx.gid else 0,
+            .inode = if (stx.mask & STATX_INO != 0) stx.ino else 0,
+            .blocks = if (stx.mask & STATX_BLOCKS != 0) stx.blocks else 0,
+        };
+    }
+};
+
+/// Nanoseconds since the epoch as i64 (years 1678-2262). Timestamps outside
+/// that range saturate instead of overflowing.
+pub fn mtimeNs(sec: anytype, nsec: anytype) i64 {
+    const ns = @as(i128, sec) * std.time.ns_per_s + nsec;
+    return std.math.cast(i64, ns) orelse if (ns < 0) @as(i64, std.math.minInt(i64)) else std.math.maxInt(i64);
+}
+
+/// Flags for statAt, computed once per directory.
+pub const StatFlags = struct {
+    dont_sync: bool = false,
+
+    /// Use cached attributes on network filesystems (no server round trip per field).
+    pub fn forDir(dir_fd: std.posix.fd_t) StatFlags {
+        return .{ .dont_sync = isNetworkFilesystem(dir_fd) };
+    }
+
+    /// statx flags: never follow symlinks, optionally skip attribute sync.
+    pub fn statxFlags(self: StatFlags) u32 {
+        var at_flags: u32 = std.posix.AT.SYMLINK_NOFOLLOW;
+        if (self.dont_sync) at_flags |= AT_STATX_DONT_SYNC;
+        return at_flags;
+    }
+};
+
+pub const StatError = error{
+    SystemOutdated,
+    FileNotFound,
+    AccessDenied,
+    NameTooLong,
+    SystemResources,
+    SymLinkLoop,
+    Unexpected,
+};
+
+/// Map a statx errno (from the syscall or an io_uring completion) to an error.
+pub fn statxError(e: std.posix.E) StatError {
+    return switch (e) {
+        .NOSYS => error.SystemOutdated,
+        .NOENT, .NOTDIR => error.FileNotFound,
+        .ACCES, .PERM => error.AccessDenied,
+        .NAMETOOLONG => error.NameTooLong,
+        .NOMEM => error.SystemResources,
+        .LOOP => error.SymLinkLoop,
+        else => std.posix.unexpectedErrno(e),
+    };
+}
+
+/// Stat `name` relative to `dir_fd` without following symlinks, fetching only `fields`
+/// (plus the file type when `need_type` is set).
+pub fn statAt(
+    dir_fd: std.posix.fd_t,
+    name: [:0]const u8,
+    fields: Fields,
+    need_type: bool,
+    flags: StatFlags,
+) !Stat {
+    if (builtin.os.tag == .linux) {
+        if (statxAt(dir_fd, name, fields.statxMask(need_type), flags)) |st| {
+            return st;
+        } else |err| switch (err) {
+            // Kernels before 4.11 have no statx - use the classic call
+            error.SystemOutdated => {},
+            else => return err,
+        }
+    }
+
+    const st = try std.posix.fstatatZ(dir_fd, name, std.posix.AT.SYMLINK_NOFOLLOW);
+    return Stat.fromPosix(st);
+}
+
+fn statxAt(dir_fd: std.posix.fd_t, name: [:0]const u8, mask: u32, flags: StatFlags) !Stat {
+    var stx: linux.Statx = undefined;
+    const rc = linux.statx(dir_fd, name, flags.statxFlags(), mask, &stx);
+    switch (std.posix.errno(rc)) {
+        .SUCCESS => return Stat.fromStatx(&stx),
+        else => |e| return statxError(e),
+    }
+}
+
+// ═══════════════════════════════════════════════════════════
+// Network filesystem detection
+// ═══════════════════════════════════════════════════════════
+
+/// statfs f_type magic numbers for filesystems where attributes live on a server.
+/// FUSE is included: sshfs, rclone, s3fs etc. all pay a round trip per getattr.
+const network_fs_magics = [_]u32{
+    0x00006969, // NFS
+    0x0000517B, // SMB
+    0xFE534D42, // SMB2
+    0xFF534D42, // CIFS
+    0x00C36400, // Ceph
+    0x5346414F, // AFS
+    0x73757245, // Coda
+    0x01021997, // 9P
+    0x0BD00BD0, // Lustre
+    0x65735546, // FUSE
+};
+
+fn isNetworkMagic(magic: u32) bool {
+    for (network_fs_magics) |m| {
+        if (m == magic) return true;
+    }
+    return false;
+}
+
+/// Check whether `fd` lives on a network filesystem. Returns false when unknown.
+fn isNetworkFilesystem(fd: std.posix.fd_t) bool {
+    // struct statfs layout differs on 32-bit targets; only probe where f_type is the first word
+    if (builtin.os.tag != .linux or @sizeOf(usize) != 8) return false;
+
+    // struct statfs is 120 bytes on 64-bit Linux; f_type is the first field
+    var buf: [16]usize = undefined;
+    const rc = linux.syscall2(.fstatfs, @as(usize, @bitCast(@as(isize, fd))), @intFromPtr(&buf));
+    if (std.posix.errno(rc) != .SUCCESS) return false;
+
+    return isNetworkMagic(@truncate(buf[0]));
+}
+
+// ═══════════════════════════════════════════════════════════
+// TESTS
+// ═══════════════════════════════════════════════════════════
+
+test "Fields.fromConfig - -1 -U needs no stat at all" {
+    var config = types.Config.default();
+    config.one_column = true;
+    config.unsorted = true;
+
+    try std.testing.expect(Fields.fromConfig(config).isEmpty());
+}
+
+test "Fields.fromConfig - -1 -U -F still needs mode for '*'" {
+    var config = types.Config.default();
+    config.one_column = true;
+    config.unsorted = true;
+    config.file_type_indicators = true;
+
+    const fields = Fields.fromConfig(config);
+    try std.testing.expect(fields.mode);
+    try std.testing.expect(!fields.size);
+    try std.testing.expect(!fields.mtime);
+}
+
+test "Fields.fromConfig - -1 -s asks for size but not mtime or owner" {
+    var config = types.Config.default();
+    config.one_column = true;
+    config.sort_by_size = true;
+
+    const fields = Fields.fromConfig(config);
+    try std.testing.expect(fields.size);
+    try std.testing.expect(!fields.mtime);
+    try std.testing.expect(!fields.owner);
+    try std.testing.expect(!fields.inode);
+}
+
+test "Fields.fromConfig - -1 -n needs no sort keys" {
+    var config = types.Config.default();
+    config.one_column = true;
+    config.sort_alphabetical = true;
+
+    const fields = Fields.fromConfig(config);
+    try std.testing.expect(!fields.size);
+    try std.testing.expect(!fields.mtime);
+}
+
+test "Fields.fromConfig - default listing" {
+    const fields = Fields.fromConfig(types.Config.default());
+    try std.testing.expect(fields.mode);
+    try std.testing.expect(fields.size);
+    try std.testing.expect(fields.mtime);
+    try std.testing.expect(!fields.owner);
+    try std.testing.expect(!fields.inode);
+}
+
+test "Fields.fromConfig - -ll -i needs owner and inode" {
+    var config = types.Config.default();
+    config.detail_level = .full;
+    config.show_inodes = true;
+
+    const fields = Fields.fromConfig(config);
+    try std.testing.expect(fields.owner);
+    try std.testing.expect(fields.inode);
+}
+
+test "Fields.fromConfig - porcelain needs mode and size only" {
+    var config = types.Config.default();
+    config.output_format = .porcelain;
+    config.unsorted = true;
+
+    const fields = Fields.fromConfig(config);
+    try std.testing.expect(fields.mode);
+    try std.testing.expect(fields.size);
+    try std.testing.expect(!fields.mtime);
+    try std.testing.expect(!fields.owner);
+}
+
+test "Fields.fromConfig - --size-mode=disk asks for blocks with the size" {
+    var config = types.Config.default();
+    config.size_mode = .disk;
+    const fields = Fields.fromConfig(config);
+    try std.testing.expect(fields.size and fields.blocks);
+    try std.testing.expect(fields.statxMask(false) & STATX_BLOCKS != 0);
+
+    config.size_mode = .apparent;
+    try std.testing.expect(!Fields.fromConfig(config).blocks);
+    config.size_mode = .disk;
+    config.one_column = true;
+    config.sort_alphabetical = true;
+    try std.testing.expect(!Fields.fromConfig(config).blocks); // No size shown or sorted on
+}
+
+test "Fields.statxMask - maps fields to statx bits" {
+    const empty = Fields{};
+    try std.testing.expectEqual(@as(u32, 0), empty.statxMask(false));
+    try std.testing.expectEqual(STATX_TYPE, empty.statxMask(true));
+
+    const size_only = Fields{ .size = true };
+    try std.testing.expectEqual(STATX_TYPE | STATX_SIZE, size_only.statxMask(false));
+
+    const owner = Fields{ .owner = true };
+    try std.testing.expectEqual(STATX_TYPE | STATX_UID | STATX_GID, owner.statxMask(false));
+}
+
+test "statxError - maps errno values" {
+    try std.testing.expectEqual(error.FileNotFound, statxError(.NOENT));
+    try std.testing.expectEqual(error.AccessDenied, statxError(.ACCES));
+    try std.testing.expectEqual(error.SystemOutdated, statxError(.NOSYS));
+}
+
+test "isNetworkMagic - known filesystems" {
+    try std.testing.expect(isNetworkMagic(0x6969)); // NFS
+    try std.testing.expect(isNetworkMagic(0xFF534D42)); // CIFS
+    try std.testing.expect(isNetworkMagic(0x65735546)); // FUSE
+    try std.testing.expect(!isNetworkMagic(0xEF53)); // ext4
+    try std.testing.expect(!isNetworkMagic(0x01021994)); // tmpfs
+}
+
+test "statAt - returns requested fields for a regular file" {
+    var tmp = std.testing.tmpDir(.{});
+    defer tmp.cleanup();
+    try tmp.dir.writeFile(.{ .sub_path = "five.txt", .data = "12345" });
+
+    const st = try statAt(tmp.dir.fd, "five.txt", .{ .size = true, .mode = true }, false, .{});
+    try std.testing.expectEqual(@as(u64, 5), st.size);
+    try std.testing.expect(std.posix.S.ISREG(st.mode));
+}
+
+test "statAt - missing file" {
+    var tmp = std.testing.tmpDir(.{});
+    defer tmp.cleanup();
+
+    try std.testing.expectError(error.FileNotFound, statAt(tmp.dir.fd, "missing", .{ .size = true }, false, .{}));
+}
+
+test "mtimeNs - converts and saturates" {
+    try std.testing.expectEqual(@as(i64, 1_500_000_000), mtimeNs(@as(i64, 1), @as(i64, 500_000_000)));
+    try std.testing.expectEqual(@as(i64, -1_000_000_000), mtimeNs(@as(i64, -1), @as(i64, 0)));
+    try std.testing.expectEqual(std.math.maxInt(i64), mtimeNs(@as(i64, 1) << 40, @as(i64, 0)));
+    try std.testing.expectEqual(std.math.minInt(i64), mtimeNs(-(@as(i64, 1) << 40), @as(i64, 0)));
+}
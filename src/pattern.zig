@@ -0,0 +1,388 @@
+//! Glob patterns for in-process filtering (`lg '*.zig'`, `--match`).
+//!
+//! Syntax: `*` any run of bytes, `?` one character (a whole UTF-8 sequence),
+//! `[abc]` / `[a-z]` / `[!x]` / `[^x]` byte classes, `\x` a literal x.
+//! Matching is against the entry's basename; `--ignore-case` folds ASCII only.
+//!
+//! Patterns compile once into tokens plus a literal prefix and suffix, so the
+//! common shapes (`foo`, `*.zig`, `test_*`, `a*b`) never run the general matcher.
+
+const std = @import("std");
+
+/// True when `s` contains glob metacharacters (used to tell patterns from file names).
+pub fn hasGlobMeta(s: []const u8) bool {
+    return std.mem.indexOfAny(u8, s, "*?[") != null;
+}
+
+const Class = struct {
+    bytes: std.StaticBitSet(256),
+    negated: bool,
+
+    fn matches(self: Class, byte: u8) bool {
+        return self.bytes.isSet(byte) != self.negated;
+    }
+};
+
+const Token = union(enum) {
+    literal: u8,
+    any,
+    star,
+    class: Class,
+};
+
+pub const Pattern = struct {
+    tokens: []const Token,
+    prefix: []const u8, // Literal bytes before the first wildcard
+    suffix: []const u8, // Literal bytes after the last wildcard
+    shape: Shape,
+    ignore_case: bool,
+
+    const Shape = enum {
+        literal,       // No wildcards: whole-name compare
+        prefix_suffix, // Only stars between prefix and suffix
+        general,       // Anything else: prefix/suffix reject, then token walk
+    };
+
+    /// Compile `source`. Tokens, prefix and suffix are allocated from `allocator`.
+    pub fn compile(allocator: std.mem.Allocator, source: []const u8, ignore_case: bool) !Pattern {
+        var tokens: std.ArrayList(Token) = .empty;
+        errdefer tokens.deinit(allocator);
+
+        var i: usize = 0;
+        while (i < source.len) {
+            const ch = source[i];
+            switch (ch) {
+                '*' => {
+                    // Collapse runs of stars
+                    if (tokens.items.len == 0 or tokens.items[tokens.items.len - 1] != .star) {
+                        try tokens.append(allocator, .star);
+                    }
+                    i += 1;
+                },
+                '?' => {
+                    try tokens.append(allocator, .any);
+                    i += 1;
+                },
+                '[' => {
+                    if (parseClass(source[i..], ignore_case)) |parsed| {
+                        try tokens.append(allocator, .{ .class = parsed.class });
+                        i += parsed.len;
+                    } else {
+                        // Unterminated class: a literal '['
+                        try tokens.append(allocator, .{ .literal = foldByte('[', ignore_case) });
+                        i += 1;
+                    }
+                },
+                '\\' => {
+                    const lit = if (i + 1 < source.len) source[i + 1] else '\\';
+                    try tokens.append(allocator, .{ .literal = foldByte(lit, ignore_case) });
+                    i += @min(2, source.len - i);
+                },
+                else => {
+                    try tokens.append(allocator, .{ .literal = foldByte(ch, ignore_case) });
+                    i += 1;
+                },
+            }
+        }
+
+        const owned = try tokens.toOwnedSlice(allocator);
+        errdefer allocator.free(owned);
+
+        var head: usize = 0;
+        while (head < owned.len and owned[head] == .literal) head += 1;
+        var tail: usize = owned.len;
+        while (tail > head and owned[tail - 1] == .literal) tail -= 1;
+
+        const prefix = try literalBytes(allocator, owned[0..head]);
+        errdefer allocator.free(prefix);
+        const suffix = try literalBytes(allocator, owned[tail..]);
+
+        const shape: Shape = if (head == owned.len)
+            .literal
+        else for (owned[head..tail]) |token| {
+            if (token != .star) break .general;
+        } else .prefix_suffix;
+
+        return .{
+            .tokens = owned,
+            .prefix = prefix,
+            .suffix = suffix,
+            .shape = shape,
+            .ignore_case = ignore_case,
+        };
+    }
+
+    pub fn deinit(self: Pattern, allocator: std.mem.Allocator) void {
+        allocator.free(self.tokens);
+        allocator.free(self.prefix);
+        allocator.free(self.suffix);
+    }
+
+    pub fn matches(self: *const Pattern, name: []const u8) bool {
+        switch (self.shape) {
+            .literal => return self.eql(name, self.prefix),
+            .prefix_suffix => {
+                if (name.len < self.prefix.len + self.suffix.len) return false;
+                return self.eql(name[0..self.prefix.len], self.prefix) and
+                    self.eql(name[name.len - self.suffix.len ..], self.suffix);
+            },
+            .general => {
+                if (name.len < self.prefix.len + self.suffix.len) return false;
+                if (!self.eql(name[0..self.prefix.len], self.prefix)) return false;
+                if (!self.eql(name[name.len - self.suffix.len ..], self.suffix)) return false;
+
+                const middle_tokens = self.tokens[self.prefix.len .. self.tokens.len - self.suffix.len];
+                const middle = name[self.prefix.len .. name.len - self.suffix.len];
+                return matchTokens(middle_tokens, middle, self.ignore_case);
+            },
+        }
+    }
+
+    /// True when the pattern can only match names starting with '.'
+    /// (so `lg '.*'` shows dotfiles without -a, like the shell).
+    pub fn wantsHidden(self: *const Pattern) bool {
+        return self.prefix.len > 0 and self.prefix[0] == '.';
+    }
+
+    fn eql(self: *const Pattern, name: []const u8, literal: []const u8) bool {
+        // `literal` is already folded when ignore_case is set
+        if (self.ignore_case) return std.ascii.eqlIgnoreCase(name, literal);
+        return std.mem.eql(u8, name, literal);
+    }
+};
+
+/// Walk `tokens` over `name` with single-star backtracking (linear in practice,
+/// O(tokens x name) worst case).
+fn matchTokens(tokens: []const Token, name: []const u8, ignore_case: bool) bool {
+    var t: usize = 0;
+    var n: usize = 0;
+    var star_t: ?usize = null;
+    var star_n: usize = 0;
+
+    while (n < name.len) {
+        if (t < tokens.len) {
+            if (tokens[t] == .star) {
+                star_t = t;
+                star_n = n;
+                t += 1;
+                continue;
+            }
+            if (advance(tokens[t], name[n..], ignore_case)) |len| {
+                t += 1;
+                n += len;
+                continue;
+            }
+        }
+        // Mismatch: let the last star swallow one more byte
+        const st = star_t orelse return false;
+        star_n += 1;
+        n = star_n;
+        t = st + 1;
+    }
+
+    while (t < tokens.len and tokens[t] == .star) t += 1;
+    return t == tokens.len;
+}
+
+/// Bytes of `rest` consumed by a non-star token, or null on mismatch.
+fn advance(token: Token, rest: []const u8, ignore_case: bool) ?usize {
+    return switch (token) {
+        .literal => |ch| if (foldByte(rest[0], ignore_case) == ch) 1 else null,
+        .any => @min(rest.len, std.unicode.utf8ByteSequenceLength(rest[0]) catch 1),
+        .class => |class| if (class.matches(foldByte(rest[0], ignore_case))) 1 else null,
+        .star => unreachable,
+    };
+}
+
+fn foldByte(byte: u8, ignore_case: bool) u8 {
+    return if (ignore_case) std.ascii.toLower(byte) else byte;
+}
+
+fn literalBytes(allocator: std.mem.Allocator, tokens: []const Token) ![]u8 {
+    const bytes = try allocator.alloc(u8, tokens.len);
+    for (tokens, bytes) |token, *byte| byte.* = token.literal;
+    return bytes;
+}
+
+/// Parse `[...]` at the start of `s`. Returns null if the class is unterminated.
+fn parseClass(s: []const u8, ignore_case: bool) ?struct { class: Class, len: usize } {
+    var class = Class{ .bytes = .initEmpty(), .negated = false };
+    var i: usize = 1;
+    if (i < s.len and (s[i] == '!' or s[i] == '^')) {
+        class.negated = true;
+        i += 1;
+    }
+
+    var first = true;
+    while (i < s.len) {
+        // ']' right after '[' or '[!' is a literal member
+        if (s[i] == ']' and !first) {
+            return .{ .class = class, .len = i + 1 };
+        }
+        first = false;
+
+        var lo = s[i];
+        if (lo == '\\' and i + 1 < s.len) {
+            i += 1;
+            lo = s[i];
+        }
+        i += 1;
+
+        var hi = lo;
+        if (i + 1 < s.len and s[i] == '-' and s[i + 1] != ']') {
+            hi = s[i + 1];
+            i += 2;
+        }
+        if (hi < lo) continue; // Empty range, like fnmatch
+
+        var b: usize = lo;
+        while (b <= hi) : (b += 1) {
+            class.bytes.set(foldByte(@intCast(b), ignore_case));
+        }
+    }
+    return null;
+}
+
+/// Any-of set of compiled patterns for one listing.
+pub const Matcher = struct {
+    patterns: []Pattern,
+    wants_hidden: bool, // Some pattern can match a dotfile without -a
+
+    pub fn init(allocator: std.mem.Allocator, sources: []const []const u8, ignore_case: bool) !Matcher {
+        const patterns = try allocator.alloc(Pattern, sources.len);
+        var compiled: usize = 0;
+        errdefer {
+            for (patterns[0..compiled]) |p| p.deinit(allocator);
+            allocator.free(patterns);
+        }
+
+        var wants_hidden = false;
+        for (sources, patterns) |source, *p| {
+            p.* = try Pattern.compile(allocator, source, ignore_case);
+            compiled += 1;
+            wants_hidden = wants_hidden or p.wantsHidden();
+        }
+        return .{ .patterns = patterns, .wants_hidden = wants_hidden };
+    }
+
+    pub fn deinit(self: Matcher, allocator: std.mem.Allocator) void {
+        for (self.patterns) |p| p.deinit(allocator);
+        allocator.free(self.patterns);
+    }
+
+    /// True when any pattern matches `name`. Unless `all` (-a), a leading
+    /// '.' is only matched by patterns that start with one, as in the shell.
+    pub fn matches(self: *const Matcher, name: []const u8, all: bool) bool {
+        const dotfile = name.len > 0 and name[0] == '.';
+        for (self.patterns) |*p| {
+            if (dotfile and !all and !p.wantsHidden()) continue;
+            if (p.matches(name)) return true;
+        }
+        return false;
+    }
+};
+
+// ═══════════════════════════════════════════════════════════
+// TESTS
+// ═══════════════════════════════════════════════════════════
+
+fn expectMatch(pattern: []const u8, name: []const u8, ignore_case: bool, expected: bool) !void {
+    const p = try Pattern.compile(std.testing.allocator, pattern, ignore_case);
+    defer p.deinit(std.testing.allocator);
+    std.testing.expectEqual(expected, p.matches(name)) catch |err| {
+        std.debug.print("pattern '{s}' vs '{s}'\n", .{ pattern, name });
+        return err;
+    };
+}
+
+test "Pattern - shapes" {
+    const allocator = std.testing.allocator;
+    const cases = .{
+        .{ "main.zig", Pattern.Shape.literal },
+        .{ "*.zig", Pattern.Shape.prefix_suffix },
+        .{ "test_*", Pattern.Shape.prefix_suffix },
+        .{ "a**b", Pattern.Shape.prefix_suffix },
+        .{ "a?b", Pattern.Shape.general },
+        .{ "*[ch]", Pattern.Shape.general },
+    };
+    inline for (cases) |case| {
+        const p = try Pattern.compile(allocator, case[0], false);
+        defer p.deinit(allocator);
+        try std.testing.expectEqual(case[1], p.shape);
+    }
+}
+
+test "Pattern - literal prefix/suffix fast path" {
+    try expectMatch("*.zig", "main.zig", false, true);
+    try expectMatch("*.zig", "main.zi", false, false);
+    try expectMatch("*.zig", ".zig", false, true);
+    try expectMatch("test_*", "test_pattern.zig", false, true);
+    try expectMatch("test_*", "tes", false, false);
+    try expectMatch("a*a", "a", false, false); // prefix and suffix may not overlap
+    try expectMatch("a*a", "aa", false, true);
+    try expectMatch("main.zig", "main.zig", false, true);
+    try expectMatch("main.zig", "main.zig2", false, false);
+}
+
+test "Pattern - general matcher" {
+    try expectMatch("a?c", "abc", false, true);
+    try expectMatch("a?c", "ac", false, false);
+    try expectMatch("*a*b*c*", "xxaxxbxxcxx", false, true);
+    try expectMatch("*a*b*c*", "xxaxxcxxbxx", false, false);
+    try expectMatch("*.[ch]", "x.c", false, true);
+    try expectMatch("*.[ch]", "x.o", false, false);
+    try expectMatch("[!.]*", ".hidden", false, false);
+    try expectMatch("[^.]*", "visible", false, true);
+    try expectMatch("file[0-9].txt", "file7.txt", false, true);
+    try expectMatch("file[0-9].txt", "filex.txt", false, false);
+    try expectMatch("[]]", "]", false, true);
+    try expectMatch("[a", "[a", false, true); // Unterminated class is literal
+}
+
+test "Pattern - escapes and UTF-8" {
+    try expectMatch("\\*.txt", "*.txt", false, true);
+    try expectMatch("\\*.txt", "a.txt", false, false);
+    try expectMatch("caf?", "caf\u{e9}", false, true); // ? eats the whole sequence
+    try expectMatch("caf?x", "caf\u{e9}x", false, true);
+}
+
+test "Pattern - ignore case" {
+    try expectMatch("*.ZIG", "main.zig", true, true);
+    try expectMatch("readme*", "README.md", true, true);
+    try expectMatch("[A-C]*", "beta", true, true);
+    try expectMatch("*.ZIG", "main.zig", false, false);
+}
+
+test "Matcher - any pattern and hidden detection" {
+    const allocator = std.testing.allocator;
+    const m = try Matcher.init(allocator, &.{ "*.zig", "Makefile" }, false);
+    defer m.deinit(allocator);
+
+    try std.testing.expect(m.matches("main.zig", false));
+    try std.testing.expect(m.matches("Makefile", false));
+    try std.testing.expect(!m.matches("README.md", false));
+    try std.testing.expect(!m.wants_hidden);
+
+    const dots = try Matcher.init(allocator, &.{".git*"}, false);
+    defer dots.deinit(allocator);
+    try std.testing.expect(dots.wants_hidden);
+}
+
+test "Matcher - the leading-dot rule is per pattern" {
+    const allocator = std.testing.allocator;
+    const m = try Matcher.init(allocator, &.{ ".*rc", "*.zig" }, false);
+    defer m.deinit(allocator);
+
+    try std.testing.expect(m.matches(".bashrc", false));
+    try std.testing.expect(m.matches("main.zig", false));
+    // '.*rc' asking for dotfiles doesn't let '*.zig' match them
+    try std.testing.expect(!m.matches(".foo.zig", false));
+    try std.testing.expect(m.matches(".foo.zig", true)); // -a
+}
+
+test "hasGlobMeta" {
+    try std.testing.expect(hasGlobMeta("*.zig"));
+    try std.testing.expect(hasGlobMeta("file?.txt"));
+    try std.testing.expect(hasGlobMeta("[ab].c"));
+    try std.testing.expect(!hasGlobMeta("main.zig"));
+}
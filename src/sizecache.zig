@@ -0,0 +1,280 @@
+//! On-disk cache of per-directory sizes for -d (--size-cache).
+//!
+//! One record per directory, keyed by (dev, inode): the blocks and the
+//! apparent size of its non-directory entries plus how many files and
+//! subdirectories it holds,
+//! validated by the directory's mtime and ctime. Adding, removing or
+//! renaming an entry changes both, so an unchanged directory is checked
+//! with one fstat and no per-file stat; the walk still visits every
+//! directory and sums the records up the tree. Rewriting a file in place
+//! doesn't touch its directory, so growth like that goes unseen until the
+//! directory itself changes - which is why the cache is opt-in.
+//!
+//! File: $XDG_CACHE_HOME/lg/dirsizes (or ~/.cache/lg/dirsizes), a header
+//! and records sorted by key, read through mmap with a binary search.
+//! Writers merge into a temp file and rename it over the old one: readers
+//! keep the file they mapped, and concurrent writers only lose each
+//! other's updates, which costs a recount.
+
+const std = @import("std");
+
+const file_name = "dirsizes";
+const magic: u32 = 0x5344474c; // "LGDS" little-endian; other byte orders miss it
+const version: u32 = 2; // 2: apparent bytes
+const max_records = 1 << 20; // 56 MiB; records not refreshed by this walk go first
+/// Directories changed this close to the walk may change again within the
+/// same timestamp tick (coarse kernel clocks, FAT): never cached
+const racy_ns: i64 = 2 * std.time.ns_per_s;
+
+pub const Record = extern struct {
+    dev: u64,
+    ino: u64,
+    mtime_ns: i64,
+    ctime_ns: i64,
+    bytes: u64, // Blocks of the non-directory entries, in bytes
+    apparent: u64, // st_size of the non-directory entries
+    files: u32, // Non-directory entries
+    subdirs: u32,
+
+    fn key(self: Record) u128 {
+        return keyOf(self.dev, self.ino);
+    }
+
+    fn lessThan(_: void, a: Record, b: Record) bool {
+        return a.key() < b.key();
+    }
+};
+
+fn keyOf(dev: u64, ino: u64) u128 {
+    return @as(u128, dev) << 64 | ino;
+}
+
+const Header = extern struct {
+    magic: u32,
+    version: u32,
+    count: u64,
+};
+
+pub const SizeCache = struct {
+    dir_path: []const u8, // Where the cache file lives; not owned
+    map: ?[]align(std.heap.page_size_min) const u8 = null,
+    records: []const Record = &.{},
+    /// Walk start, for the racy check in record()
+    now_ns: i128,
+
+    /// Map the cache file in `dir_path` (see defaultDir). Any problem
+    /// (missing, foreign, truncated) gives an empty cache rather than an
+    /// error: it only ever saves work.
+    pub fn open(dir_path: []const u8) SizeCache {
+        var self = SizeCache{ .dir_path = dir_path, .now_ns = std.time.nanoTimestamp() };
+        var dir = std.fs.openDirAbsolute(dir_path, .{}) catch return self;
+        defer dir.close();
+        const file = dir.openFile(file_name, .{}) catch return self;
+        defer file.close();
+
+        const size = (file.stat() catch return self).size;
+        if (size < @sizeOf(Header)) return self;
+        const map = std.posix.mmap(null, size, std.posix.PROT.READ, .{ .TYPE = .PRIVATE }, file.handle, 0) catch return self;
+        const records = parse(map) orelse {
+            std.posix.munmap(map);
+            return self;
+        };
+        self.map = map;
+        self.records = records;
+        return self;
+    }
+
+    pub fn close(self: *SizeCache) void {
+        if (self.map) |map| std.posix.munmap(map);
+        self.map = null;
+        self.records = &.{};
+    }
+
+    /// The record for a directory, if it is still valid for `st`.
+    pub fn lookup(self: *const SizeCache, st: std.posix.Stat) ?Record {
+        const key = keyOf(@intCast(st.dev), @intCast(st.ino));
+        var lo: usize = 0;
+        var hi: usize = self.records.len;
+        while (lo < hi) {
+            const mid = lo + (hi - lo) / 2;
+            if (self.records[mid].key() < key) lo = mid + 1 else hi = mid;
+        }
+        if (lo == self.records.len or self.records[lo].key() != key) return null;
+        const entry = self.records[lo];
+        if (entry.mtime_ns != timeNs(st.mtime()) or entry.ctime_ns != timeNs(st.ctime())) return null;
+        return entry;
+    }
+
+    /// A record for a directory just counted, or null if it changed too
+    /// recently to trust its timestamps.
+    pub fn record(self: *const SizeCache, st: std.posix.Stat, bytes: u64, apparent: u64, files: u32, subdirs: u32) ?Record {
+        const mtime = timeNs(st.mtime());
+        const ctime = timeNs(st.ctime());
+        if (@max(mtime, ctime) > self.now_ns - racy_ns) return null;
+        return .{ .dev = @intCast(st.dev), .ino = @intCast(st.ino), .mtime_ns = mtime, .ctime_ns = ctime, .bytes = bytes, .apparent = apparent, .files = files, .subdirs = subdirs };
+    }
+
+    /// Merge `fresh` over the mapped records and replace the file. Best
+    /// effort: an unwritable cache directory just means no cache.
+    pub fn save(self: *const SizeCache, allocator: std.mem.Allocator, fresh: []Record) void {
+        self.write(allocator, fresh) catch {};
+    }
+
+    fn write(self: *const SizeCache, allocator: std.mem.Allocator, fresh: []Record) !void {
+        if (fresh.len == 0) return;
+        std.mem.sort(Record, fresh, {}, Record.lessThan);
+        const merged = try merge(allocator, self.records, fresh);
+        defer allocator.free(merged);
+
+        try std.fs.cwd().makePath(self.dir_path);
+        var dir = try std.fs.openDirAbsolute(self.dir_path, .{});
+        defer dir.close();
+
+        var tmp_buf: [64]u8 = undefined;
+        const tmp_name = try std.fmt.bufPrint(&tmp_buf, "dirsizes.{d}.tmp", .{std.c.getpid()});
+        const file = try dir.createFile(tmp_name, .{}); // Per-process name; a stale one is ours to reuse
+        errdefer dir.deleteFile(tmp_name) catch {};
+        {
+            defer file.close();
+            var buffer: [64 * 1024]u8 = undefined;
+            var writer = file.writer(&buffer);
+            const header = Header{ .magic = magic, .version = version, .count = merged.len };
+            try writer.interface.writeAll(std.mem.asBytes(&header));
+            try writer.interface.writeAll(std.mem.sliceAsBytes(merged));
+            try writer.interface.flush();
+        }
+        try dir.rename(tmp_name, file_name);
+    }
+};
+
+/// Records of a mapped cache file, or null if it isn't one of ours.
+fn parse(data: []align(std.heap.page_size_min) const u8) ?[]const Record {
+    const header: *const Header = @ptrCast(data.ptr);
+    if (header.magic != magic or header.version != version) return null;
+    const body = data[@sizeOf(Header)..];
+    if (body.len % @sizeOf(Record) != 0 or body.len / @sizeOf(Record) != header.count) return null;
+    return std.mem.bytesAsSlice(Record, body);
+}
+
+/// Sorted union of two sorted record lists, `fresh` winning on equal keys.
+/// Over max_records, keeps every fresh record it can and drops old ones.
+fn merge(allocator: std.mem.Allocator, old: []const Record, fresh: []const Record) ![]Record {
+    const keep_old = @min(old.len, max_records -| fresh.len);
+    const out = try allocator.alloc(Record, @min(old.len + fresh.len, max_records));
+    var len: usize = 0;
+    var i: usize = 0;
+    var j: usize = 0;
+    var old_kept: usize = 0;
+    while (len < out.len and (i < old.len or j < fresh.len)) {
+        if (j < fresh.len and (i == old.len or fresh[j].key() <= old[i].key())) {
+            if (i < old.len and fresh[j].key() == old[i].key()) i += 1;
+            // Duplicates within fresh: the last one counted wins
+            if (len > 0 and out[len - 1].key() == fresh[j].key()) len -= 1;
+            out[len] = fresh[j];
+            j += 1;
+        } else {
+            if (old_kept == keep_old) {
+                i += 1;
+                continue;
+            }
+            out[len] = old[i];
+            old_kept += 1;
+            i += 1;
+        }
+        len += 1;
+    }
+    return allocator.realloc(out, len);
+}
+
+/// `$XDG_CACHE_HOME/lg`, falling back to `~/.cache/lg`. Null when neither
+/// is set (or XDG_CACHE_HOME is relative, which the spec says to ignore).
+pub fn defaultDir(buf: []u8) ?[]const u8 {
+    if (std.posix.getenv("XDG_CACHE_HOME")) |xdg| {
+        if (xdg.len > 0 and xdg[0] == '/') return std.fmt.bufPrint(buf, "{s}/lg", .{xdg}) catch null;
+    }
+    const home = std.posix.getenv("HOME") orelse return null;
+    return std.fmt.bufPrint(buf, "{s}/.cache/lg", .{home}) catch null;
+}
+
+fn timeNs(ts: anytype) i64 {
+    return std.math.cast(i64, @as(i128, ts.sec) * std.time.ns_per_s + ts.nsec) orelse std.math.maxInt(i64);
+}
+
+// ═══════════════════════════════════════════════════════════
+// TESTS
+// ═══════════════════════════════════════════════════════════
+
+fn testRecord(dev: u64, ino: u64, bytes: u64) Record {
+    return .{ .dev = dev, .ino = ino, .mtime_ns = 1, .ctime_ns = 2, .bytes = bytes, .apparent = bytes, .files = 0, .subdirs = 0 };
+}
+
+test "Record - compact, fixed layout" {
+    try std.testing.expectEqual(@as(usize, 56), @sizeOf(Record));
+    try std.testing.expectEqual(@as(usize, 16), @sizeOf(Header));
+}
+
+test "merge - fresh records win, output stays sorted" {
+    const allocator = std.testing.allocator;
+    const old = [_]Record{ testRecord(1, 1, 10), testRecord(1, 5, 50), testRecord(2, 1, 70) };
+    var fresh = [_]Record{ testRecord(1, 3, 30), testRecord(1, 5, 55) };
+    const merged = try merge(allocator, &old, &fresh);
+    defer allocator.free(merged);
+
+    try std.testing.expectEqual(@as(usize, 4), merged.len);
+    const bytes = [_]u64{ 10, 30, 55, 70 };
+    for (merged, bytes) |record, expected| try std.testing.expectEqual(expected, record.bytes);
+}
+
+test "parse - rejects foreign and truncated files" {
+    var data: [@sizeOf(Header) + 2 * @sizeOf(Record)]u8 align(std.heap.page_size_min) = undefined;
+    const header = Header{ .magic = magic, .version = version, .count = 2 };
+    @memcpy(data[0..@sizeOf(Header)], std.mem.asBytes(&header));
+    const records = [_]Record{ testRecord(1, 1, 10), testRecord(1, 2, 20) };
+    @memcpy(data[@sizeOf(Header)..], std.mem.sliceAsBytes(&records));
+
+    try std.testing.expectEqual(@as(usize, 2), parse(&data).?.len);
+    try std.testing.expect(parse(data[0 .. data.len - 8]) == null);
+    data[0] ^= 0xff;
+    try std.testing.expect(parse(&data) == null);
+}
+
+test "SizeCache - lookup checks both timestamps, record skips racy directories" {
+    var tmp = std.testing.tmpDir(.{});
+    defer tmp.cleanup();
+    const st = try std.posix.fstat(tmp.dir.fd);
+
+    // Just created: too recent to cache
+    var cache = SizeCache{ .dir_path = "/nonexistent", .now_ns = std.time.nanoTimestamp() };
+    try std.testing.expect(cache.record(st, 1, 1, 1, 0) == null);
+
+    // Seen from far enough in the future it is stable
+    cache.now_ns += 10 * std.time.ns_per_s;
+    const fresh = [_]Record{cache.record(st, 4096, 100, 3, 1).?};
+    cache.records = &fresh;
+    try std.testing.expectEqual(@as(u64, 4096), cache.lookup(st).?.bytes);
+
+    var changed = st;
+    changed.ctim.nsec +%= 1;
+    try std.testing.expect(cache.lookup(changed) == null);
+}
+
+test "SizeCache - save and reopen round trip" {
+    const allocator = std.testing.allocator;
+    var tmp = std.testing.tmpDir(.{});
+    defer tmp.cleanup();
+    const path = try tmp.dir.realpathAlloc(allocator, ".");
+    defer allocator.free(path);
+    const dir_path = try std.fs.path.join(allocator, &.{ path, "lg" });
+    defer allocator.free(dir_path);
+
+    var empty = SizeCache.open(dir_path);
+    defer empty.close();
+    try std.testing.expectEqual(@as(usize, 0), empty.records.len);
+    var fresh = [_]Record{ testRecord(3, 1, 30), testRecord(1, 1, 10) };
+    empty.save(allocator, &fresh);
+
+    var cache = SizeCache.open(dir_path);
+    defer cache.close();
+    try std.testing.expectEqual(@as(usize, 2), cache.records.len);
+    try std.testing.expectEqual(@as(u64, 10), cache.records[0].bytes); // Sorted on save
+}
@@ -1,7 +1,8 @@
 //! Core type definitions for zig-lg.
 //!
 //! Config: User preferences from CLI (flags, paths, output format)
-//! FileInfo: Per-file metadata + git status + file kind
+//! FileInfo: Per-file metadata + git status (kind lives in the mode bits)
+//! Listing: FileInfo array plus the name arena its NameRefs point into
 //! GitStatus: Enum with priority system (unstaged > staged > untracked > clean)
 //! FileKind: Union enum distinguishing dirs, symlinks, executable vs regular files
 
@@ -14,11 +15,9 @@ const std = @import("std");
 /// Buffer size for stdout buffering (legend, branch info, etc.)
 pub const STDOUT_BUFFER_SIZE = 512;
 
-/// Max output size for git status command (1MB should be sufficient)
-pub const GIT_STATUS_MAX_OUTPUT = 1024 * 1024;
-
-/// Max output size for du command (10MB for large directory trees)
-pub const DU_MAX_OUTPUT = 10 * 1024 * 1024;
+/// Read buffer for streaming `git status` output. Bounds one porcelain
+/// record (fixed fields plus a path), not the whole output.
+pub const GIT_STATUS_BUFFER_SIZE = 64 * 1024;
 
 pub const DetailLevel = enum {
     minimal,
@@ -29,9 +28,38 @@ pub const DetailLevel = enum {
 pub const OutputFormat = enum {
     normal,
     json,
+    ndjson,    // One JSON object per line, for streaming into other tools
     porcelain,
 };
 
+/// Metadata collection strategy for listFiles (--stat-backend).
+pub const StatBackend = enum {
+    auto,     // Pick by entry count and platform
+    serial,   // One statx/fstatat per entry on the calling thread
+    threads,  // Worker pool (see --jobs)
+    io_uring, // Batched IORING_OP_STATX (Linux 5.6+), falls back to threads/serial
+};
+
+/// Which size the Size column shows (--size-mode). Unset, files show
+/// st_size and -d directories their disk usage, as `ls` and `du` do.
+pub const SizeMode = enum {
+    apparent, // st_size, and its sum for -d (`du --apparent-size`)
+    disk,     // Allocated blocks: sparse and compressed files show less
+};
+
+/// How `git status` is invoked. Null leaves the choice to git (and the
+/// user's git config); each setting trades detail for latency.
+pub const GitOptions = struct {
+    branch: bool = false,                  // --branch: also read "# branch.*" headers
+    renames: ?bool = null,                 // --git-no-renames: skip rename detection
+    untracked: ?UntrackedMode = null,      // --git-untracked=MODE
+    submodules: ?SubmoduleMode = null,     // --git-submodules=MODE
+    timeout_ns: ?u64 = null,               // --git-timeout=DURATION: kill git, mark entries unknown
+
+    pub const UntrackedMode = enum { no, normal, all };
+    pub const SubmoduleMode = enum { none, untracked, dirty, all };
+};
+
 pub const Config = struct {
     dir_path: []const u8,
     detail_level: DetailLevel,
@@ -40,9 +68,15 @@ pub const Config = struct {
     sort_alphabetical: bool,
     show_branch: bool,
     show_legend: bool,
-    calc_dir_sizes: bool,        // -d: Run du -sk (slow on large dirs!)
+    calc_dir_sizes: bool,        // -d: Walk every subtree for recursive sizes (slow on large dirs!)
+    size_budget_ns: ?u64,        // --size-budget=DURATION: stop the -d walk, show partial sums
+    size_mode: ?SizeMode,        // --size-mode=MODE: apparent or disk sizes for files and -d
+    show_counts: bool,           // --counts: -d Files/Dirs columns (descendants of each directory)
+    size_cache: bool,            // --size-cache: reuse -d sums of unchanged directories
     group_by_type: bool,         // -t: Group dirs first, then by extension (adds blank lines)
     file_filters: ?[]const []const u8,
+    patterns: ?[]const []const u8, // Globs from --match or quoted positionals
+    ignore_case: bool,             // --ignore-case: ASCII case-insensitive patterns
     // Phase 1 flags
     reverse_order: bool,
     sort_by_size: bool,
@@ -57,6 +91,11 @@ pub const Config = struct {
     omit_group: bool,            // -o
     omit_owner: bool,            // -g
     sort_by_extension: bool,     // -X: Sort by file extension (like ls -X)
+    // Performance tuning
+    jobs: usize,                 // --jobs N: stat worker threads (0 = auto by entry count)
+    stat_backend: StatBackend,   // --stat-backend: force a metadata backend
+    show_timing: bool,           // --timing: print phase timings to stderr
+    git: GitOptions,             // --git-*: git status tuning
 
     pub fn default() Config {
         return .{
@@ -68,8 +107,14 @@ pub const Config = struct {
             .show_branch = false,
             .show_legend = false,
             .calc_dir_sizes = false,
+            .size_budget_ns = null,
+            .size_mode = null,
+            .show_counts = false,
+            .size_cache = false,
             .group_by_type = false,
             .file_filters = null,
+            .patterns = null,
+            .ignore_case = false,
             .reverse_order = false,
             .sort_by_size = false,
             .show_inodes = false,
@@ -81,20 +126,132 @@ pub const Config = struct {
             .omit_group = false,
             .omit_owner = false,
             .sort_by_extension = false,
+            .jobs = 0,
+            .stat_backend = .auto,
+            .show_timing = false,
+            .git = .{},
         };
     }
 };
 
-pub const FileInfo = struct {
+/// Offset and length of a name inside a Listing's name arena.
+pub const NameRef = struct {
+    off: u32,
+    len: u32,
+
+    /// The name this ref points to inside `bytes` (a NameArena's contents).
+    pub fn in(self: NameRef, bytes: []const u8) [:0]const u8 {
+        return bytes[self.off .. self.off + self.len :0];
+    }
+};
+
+/// Growable byte arena holding every name of a listing back to back.
+/// Each name is followed by a NUL so it can go straight to statx/fstatat.
+pub const NameArena = struct {
+    bytes: std.ArrayList(u8) = .empty,
+
+    pub fn append(self: *NameArena, allocator: std.mem.Allocator, name: []const u8) !NameRef {
+        const off = std.math.cast(u32, self.bytes.items.len) orelse return error.NameArenaFull;
+        const len = std.math.cast(u32, name.len) orelse return error.NameArenaFull;
+        if (self.bytes.items.len + name.len + 1 > std.math.maxInt(u32)) return error.NameArenaFull;
+        try self.bytes.ensureUnusedCapacity(allocator, name.len + 1);
+        self.bytes.appendSliceAssumeCapacity(name);
+        self.bytes.appendAssumeCapacity(0);
+        return .{ .off = off, .len = len };
+    }
+
+    pub fn get(self: *const NameArena, ref: NameRef) [:0]const u8 {
+        return ref.in(self.bytes.items);
+    }
+
+    pub fn deinit(self: *NameArena, allocator: std.mem.Allocator) void {
+        self.bytes.deinit(allocator);
+    }
+};
+
+/// Files and directories under a -d directory (--counts).
+pub const TreeCount = struct {
+    files: u64,
+    dirs: u64,
+};
+
+/// TreeCounts keyed by the entry's NameRef offset, which sorting doesn't
+/// change. Kept beside the listing so FileInfo stays compact.
+pub const TreeCounts = std.AutoHashMapUnmanaged(u32, TreeCount);
+
+/// A directory listing: compact entries plus the arena their names live in.
+pub const Listing = struct {
+    files: []FileInfo,
+    names: []const u8,
+    counts: ?*const TreeCounts = null, // --counts, filled in with the -d sums
+
+    pub const empty: Listing = .{ .files = &.{}, .names = &.{} };
+
+    pub fn name(self: Listing, file: FileInfo) [:0]const u8 {
+        return file.name.in(self.names);
+    }
+
+    /// --counts figures for `file`, if it is a -d directory.
+    pub fn count(self: Listing, file: FileInfo) ?TreeCount {
+        const counts = self.counts orelse return null;
+        return counts.get(file.name.off);
+    }
+
+    pub fn deinit(self: Listing, allocator: std.mem.Allocator) void {
+        allocator.free(self.files);
+        allocator.free(self.names);
+    }
+
+    /// Build a listing from literal specs (tests and fixtures).
+    pub fn fromSpecs(allocator: std.mem.Allocator, specs: []const FileSpec) !Listing {
+        var arena: NameArena = .{};
+        defer arena.deinit(allocator);
+        const files = try allocator.alloc(FileInfo, specs.len);
+        errdefer allocator.free(files);
+
+        for (specs, files) |spec, *file| {
+            file.* = .{
+                .name = try arena.append(allocator, spec.name),
+                .mode = FileInfo.packMode(spec.mode, spec.kind),
+                .size = spec.size,
+                .mtime = spec.mtime,
+                .uid = spec.uid,
+                .gid = spec.gid,
+                .git_status = spec.git_status,
+                .inode = spec.inode,
+            };
+        }
+
+        return .{ .files = files, .names = try arena.bytes.toOwnedSlice(allocator) };
+    }
+};
+
+/// FileInfo fields spelled out, with the name as a slice and the kind as a union.
+pub const FileSpec = struct {
     name: []const u8,
-    mode: std.posix.mode_t,
+    mode: std.posix.mode_t = 0o644,
+    size: u64 = 0,
+    mtime: i64 = 0,
+    uid: std.posix.uid_t = 0,
+    gid: std.posix.gid_t = 0,
+    git_status: FileInfo.GitStatus = .clean,
+    kind: FileInfo.FileKind = .{ .file = .{ .executable = false } },
+    inode: u64 = 0,
+};
+
+/// Per-entry metadata, kept to 48 bytes:
+/// the name is a NameRef into the Listing arena, mtime is i64 nanoseconds and the
+/// kind is read from the S_IFMT bits of `mode` (executable from its x bits).
+pub const FileInfo = struct {
+    mtime: i64, // ns since the epoch
     size: u64,
-    mtime: i128,
+    inode: u64,
+    name: NameRef,
+    mode: std.posix.mode_t, // always carries S_IFDIR/S_IFLNK/S_IFREG
     uid: std.posix.uid_t,
     gid: std.posix.gid_t,
     git_status: GitStatus,
-    kind: FileKind,
-    inode: u64,
+    size_state: SizeState = .exact, // -d sums: final, still walking, or cut short
 
     // FileKind: Tagged union for file type discrimination
     // - file: Regular file (may or may not be executable)
@@ -106,6 +263,37 @@ pub const FileInfo = struct {
         symlink,
     };
 
+    pub fn kind(self: FileInfo) FileKind {
+        return switch (self.mode & std.posix.S.IFMT) {
+            std.posix.S.IFDIR => .directory,
+            std.posix.S.IFLNK => .symlink,
+            else => .{ .file = .{ .executable = (self.mode & 0o111) != 0 } },
+        };
+    }
+
+    pub fn isDir(self: FileInfo) bool {
+        return (self.mode & std.posix.S.IFMT) == std.posix.S.IFDIR;
+    }
+
+    /// Combine permission bits with the type bits for `k`. Executable files
+    /// without any x bit get u+x so kind() round-trips.
+    pub fn packMode(perm: std.posix.mode_t, k: FileKind) std.posix.mode_t {
+        const bits = perm & 0o7777;
+        return switch (k) {
+            .directory => std.posix.S.IFDIR | bits,
+            .symlink => std.posix.S.IFLNK | bits,
+            .file => |f| std.posix.S.IFREG | if (f.executable)
+                (if (bits & 0o111 == 0) bits | 0o100 else bits)
+            else
+                bits & ~@as(std.posix.mode_t, 0o111),
+        };
+    }
+
+    /// Whether `size` is final. Only -d directory sums are ever anything
+    /// but exact: pending while their subtree is walked, partial (a lower
+    /// bound) when --size-budget stopped the walk first.
+    pub const SizeState = enum(u8) { exact, pending, partial };
+
     // GitStatus priority system (for conflict resolution):
     // 1. Unstaged changes (most urgent - uncommitted work)
     // 2. Staged changes (ready to commit)
@@ -126,6 +314,7 @@ pub const FileInfo = struct {
         unstaged_copied = 'c',
         untracked = '?',
         ignored = '!',
+        unknown = '~', // git ran past --git-timeout and was killed
 
         pub fn symbol(self: GitStatus) []const u8 {
             return switch (self) {
@@ -133,6 +322,7 @@ pub const FileInfo = struct {
                 .unstaged_modified, .unstaged_added, .unstaged_deleted, .unstaged_renamed, .unstaged_copied => " ○",
                 .untracked => " ?",
                 .ignored => " !",
+                .unknown => " ~",
                 .clean => " ·",
             };
         }
@@ -152,6 +342,7 @@ pub const FileInfo = struct {
                 .unstaged_copied => "git_unstaged_copied",
                 .untracked => "git_untracked",
                 .ignored => "git_ignored",
+                .unknown => "git_unknown",
                 .clean => "git_clean",
             };
         }
@@ -186,9 +377,10 @@ test "DetailLevel enum has three variants" {
     try std.testing.expectEqual(DetailLevel.full, .full);
 }
 
-test "OutputFormat enum has three variants" {
+test "OutputFormat enum variants" {
     try std.testing.expectEqual(OutputFormat.normal, .normal);
     try std.testing.expectEqual(OutputFormat.json, .json);
+    try std.testing.expectEqual(OutputFormat.ndjson, .ndjson);
     try std.testing.expectEqual(OutputFormat.porcelain, .porcelain);
 }
 
@@ -215,6 +407,7 @@ test "GitStatus.symbol staged vs unstaged distinction" {
 
 test "GitStatus.symbol special statuses" {
     try std.testing.expectEqualStrings(" !", FileInfo.GitStatus.ignored.symbol());
+    try std.testing.expectEqualStrings(" ~", FileInfo.GitStatus.unknown.symbol());
 }
 
 test "GitStatus.colorName returns valid names" {
@@ -264,19 +457,68 @@ test "FileKind can be symlink" {
 
 test "FileInfo can be constructed" {
     const info = FileInfo{
-        .name = "test.txt",
-        .mode = 0o644,
+        .name = .{ .off = 0, .len = 8 },
+        .mode = FileInfo.packMode(0o644, .{ .file = .{ .executable = false } }),
         .size = 1024,
         .mtime = 0,
         .uid = 1000,
         .gid = 1000,
         .git_status = .clean,
-        .kind = .{ .file = .{ .executable = false } },
         .inode = 12345,
     };
-    try std.testing.expectEqualStrings("test.txt", info.name);
     try std.testing.expectEqual(@as(u64, 1024), info.size);
     try std.testing.expectEqual(FileInfo.GitStatus.clean, info.git_status);
+    try std.testing.expect(info.kind() == .file);
+}
+
+test "FileInfo is compact" {
+    try std.testing.expect(@sizeOf(FileInfo) <= 48);
+}
+
+test "FileInfo.kind round-trips through packMode" {
+    const kinds = [_]FileInfo.FileKind{
+        .directory,
+        .symlink,
+        .{ .file = .{ .executable = true } },
+        .{ .file = .{ .executable = false } },
+    };
+    for (kinds) |k| {
+        const info = FileInfo{ .name = .{ .off = 0, .len = 0 }, .mode = FileInfo.packMode(0o755, k), .size = 0, .mtime = 0, .uid = 0, .gid = 0, .git_status = .clean, .inode = 0 };
+        try std.testing.expectEqual(k, info.kind());
+    }
+    // Permission bits survive, type bits don't leak into them
+    try std.testing.expectEqual(@as(std.posix.mode_t, 0o750), FileInfo.packMode(0o750, .directory) & 0o7777);
+    try std.testing.expect((FileInfo.packMode(0o644, .{ .file = .{ .executable = true } }) & 0o100) != 0);
+}
+
+test "NameArena - names are contiguous and NUL-terminated" {
+    const allocator = std.testing.allocator;
+    var arena: NameArena = .{};
+    defer arena.deinit(allocator);
+
+    const a = try arena.append(allocator, "alpha");
+    const b = try arena.append(allocator, "");
+    const c = try arena.append(allocator, "gamma.txt");
+
+    try std.testing.expectEqualStrings("alpha", arena.get(a));
+    try std.testing.expectEqualStrings("", arena.get(b));
+    try std.testing.expectEqualStrings("gamma.txt", arena.get(c));
+    try std.testing.expectEqual(@as(u32, 6), b.off);
+    try std.testing.expectEqual(@as(usize, 0), arena.get(c).ptr[c.len]);
+}
+
+test "Listing.fromSpecs - names and kinds" {
+    const allocator = std.testing.allocator;
+    const listing = try Listing.fromSpecs(allocator, &.{
+        .{ .name = "src", .kind = .directory, .mode = 0o755 },
+        .{ .name = "run.sh", .kind = .{ .file = .{ .executable = true } }, .mode = 0o755 },
+    });
+    defer listing.deinit(allocator);
+
+    try std.testing.expectEqualStrings("src", listing.name(listing.files[0]));
+    try std.testing.expectEqualStrings("run.sh", listing.name(listing.files[1]));
+    try std.testing.expect(listing.files[0].isDir());
+    try std.testing.expect(listing.files[1].kind().file.executable);
 }
 
 test "GitStatus enum discriminants match char values" {